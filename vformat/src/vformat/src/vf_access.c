@@ -132,6 +132,8 @@ static const char vf_access_c_vss_id[] = "$Header: /cvsroot/vformat/src/vformat/
 #include "vf_strings.h"
 #include "vf_string_arrays.h"
 #include "vf_modified.h"
+#include "vf_arena.h"
+#include "vf_atoms.h"
 
 /*===========================================================================*
  Public Data
@@ -145,6 +147,16 @@ static const char vf_access_c_vss_id[] = "$Header: /cvsroot/vformat/src/vformat/
 #define MAXINCREMENT        (5)
 #define MAXNUMTAGS          (10)
 
+/*
+ * Result of match_tag(), the tags we look for are all upper case ASCII.
+ */
+#define TAG_NONE            (0)
+#define TAG_NOCASE          (1)
+#define TAG_EXACT           (2)
+
+#define TAG_UPPER(c) \
+    ((('a' <= (c)) && ((c) <= 'z')) ? (char)((c) - 'a' + 'A') : (char)(c))
+
 /*===========================================================================*
  Private Data Types
  *===========================================================================*/
@@ -177,6 +189,17 @@ static bool_t set_prop_value_base64(
     bool_t copy                 /* Copy or keep pointer */
     );
 
+static vf_encoding_t scan_name_field(
+    const char *p_string,       /* The name field */
+    uint32_t *p_bits,           /* Output VPQ_CHARSET & VPQ_ENCODING bits */
+    uint32_t *p_length          /* Output length of the field */
+    );
+
+static int match_tag(
+    const char *p_chars,        /* Where the tag might start */
+    const char *p_tag           /* The tag */
+    );
+
 /*===========================================================================*
  Private Data
  *===========================================================================*/
@@ -299,6 +322,11 @@ bool_t vf_get_prop_value(
     VPROP_T *p_vprop = (VPROP_T *)p_prop;
     bool_t ret = TRUE;
 
+    if (!decode_lazy_value(p_vprop))
+    {
+        return FALSE;
+    }
+
     switch (p_vprop->value.encoding)
     {
     case VF_ENC_VOBJECT:
@@ -374,9 +402,18 @@ bool_t vf_set_prop_value(
     if (!copy)
         return FALSE;
 
+    /* New values come from the heap, even in an arena tree */
+
+    arena_note_heap_use(p_vprop);
+
     if (encoding == p_vprop->value.encoding)
     {
-        /* Leave it as is */
+        /* Leave it as is, other than decoding it */
+
+        if (!decode_lazy_value(p_vprop))
+        {
+            return FALSE;
+        }
     }
     else
     {
@@ -420,6 +457,87 @@ bool_t vf_set_prop_value(
     return ret;
 }
 
+/*---------------------------------------------------------------------------*
+ * NAME
+ *      classify_prop_name()
+ * 
+ * DESCRIPTION
+ *      Work out the qualifiers, n_charset & n_encoding fields of a property
+ *      from its name fields.  Atoms carry their VPQ_ bits & encoding, other
+ *      fields are scanned by scan_name_field().
+ *
+ *      QUOTED-PRINTABLE anywhere in the name takes precedence over BASE64
+ *      which takes precedence over 8BIT.
+ *
+ * RETURNS
+ *      The encoding the name fields ask for.
+ *---------------------------------------------------------------------------*/
+
+vf_encoding_t classify_prop_name(
+    VPROP_T *p_prop             /* The property */
+    )
+{
+    vf_encoding_t ret = VF_ENC_7BIT;
+    uint32_t i;
+
+    p_prop->qualifiers = 0;
+    p_prop->n_charset = 0;
+    p_prop->n_encoding = 0;
+
+    for (i = 0;i < p_prop->name.n_strings;i++)
+    {
+        const char *p_string = p_prop->name.pp_strings[i];
+        vf_encoding_t enc = VF_ENC_7BIT;
+        uint32_t bits = 0;
+
+        if (!p_string)
+        {
+            /* Nothing to check */
+        }
+        else
+        if (IS_ATOM(p_string))
+        {
+            enc = atom_encoding(p_string);
+            bits = atom_qualifier(p_string);
+        }
+        else
+        {
+            const char *p_atom;
+            uint32_t length;
+
+            enc = scan_name_field(p_string, &bits, &length);
+
+            p_atom = atom_find(p_string, length, FALSE);
+
+            if (p_atom)
+            {
+                bits |= atom_qualifier(p_atom) & VPQ_TYPES;
+            }
+        }
+
+        if ((bits & VPQ_CHARSET) && !p_prop->n_charset)
+        {
+            p_prop->n_charset = 1 + i;
+        }
+
+        if ((bits & VPQ_ENCODING) && !p_prop->n_encoding)
+        {
+            p_prop->n_encoding = 1 + i;
+        }
+
+        p_prop->qualifiers |= bits;
+
+        if ((VF_ENC_QUOTEDPRINTABLE == enc) ||
+            ((VF_ENC_BASE64 == enc) && (VF_ENC_QUOTEDPRINTABLE != ret)) ||
+            ((VF_ENC_8BIT == enc) && (VF_ENC_7BIT == ret)))
+        {
+            ret = enc;
+        }
+    }
+
+    return ret;
+}
+
 /*===========================================================================*
  Private Function Implementations
  *===========================================================================*/
@@ -458,6 +576,8 @@ bool_t set_prop_value_string(
     else
     if ((-1) == n_string)
     {
+        mark_property_modified(p_vprop, TRUE);
+
         ret = add_string_to_array(&(p_vprop->value.v.s), p_string);
     }
 
@@ -492,6 +612,9 @@ bool_t set_prop_value_base64(
         {
             p_memcpy(p_vprop->value.v.b.p_buffer, p_data, length);
             p_vprop->value.v.b.n_bufsize = length;
+            p_vprop->value.v.b.n_alloc = length;
+
+            mark_property_modified(p_vprop, TRUE);
 
             ret = TRUE;
         }
@@ -534,20 +657,17 @@ bool_t strings_valid_index(
     {
         /* Set string within reasonable expansion of object */
 
-        void *p_tmp = vf_realloc(p_vprop->value.v.s.pp_strings, (1 + n_string) * sizeof(char *));
-
-        if (p_tmp)
+        if (grow_string_array(&(p_vprop->value.v.s), 1 + n_string))
         {
             uint32_t i;
 
-            p_vprop->value.v.s.pp_strings = (char **)p_tmp;
-
             for (i = p_vprop->value.v.s.n_strings;i < (uint32_t)(1 + n_string);i++)
             {
                 p_vprop->value.v.s.pp_strings[i] = NULL;
             }
 
             p_vprop->value.v.s.n_strings = (1 + n_string);
+            p_vprop->value.v.s.n_curalloc = 0;
 
             ret = TRUE;
         }
@@ -577,28 +697,12 @@ bool_t ensure_value_encoding_tag(
     )
 {
     uint32_t n;
-    uint32_t i;
     bool_t ret = TRUE;
 
     /*
      * Locate the encoding value.
      */
-    for (i = 0, n = (uint32_t)(-1);n == (-1) && (i < p_vprop->name.n_strings);i++)
-    {
-        const char *p_string = p_vprop->name.pp_strings[i];
-
-        if (p_string)
-        {
-            if (p_stristr(p_string, VFP_ENCODING)
-                || p_stristr(p_string, VFP_QUOTEDPRINTABLE)
-                || p_stristr(p_string, VFP_BASE64)
-                || p_stristr(p_string, VFP_8BIT)
-                || p_stristr(p_string, VFP_7BIT))
-            {
-                n = i;
-            }
-        }
-    }
+    n = p_vprop->n_encoding ? (p_vprop->n_encoding - 1) : (uint32_t)(-1);
 
     /*
      * Remove previous encoding
@@ -639,6 +743,8 @@ bool_t ensure_value_encoding_tag(
         }
     }
 
+    classify_prop_name(p_vprop);
+
     if (ret)
     {
         p_vprop->value.encoding = encoding;
@@ -647,6 +753,129 @@ bool_t ensure_value_encoding_tag(
     return ret;
 }
 
+/*---------------------------------------------------------------------------*
+ * NAME
+ *      scan_name_field()
+ * 
+ * DESCRIPTION
+ *      One pass over a name field which isn't an atom.  It names an encoding
+ *      if it contains one of the encoding tags in any case, CHARSET only
+ *      counts in upper case.  The encoding it asks for is the one it spells
+ *      exactly, QUOTED-PRINTABLE before BASE64 before 8BIT.
+ *
+ * RETURNS
+ *      The encoding the field asks for.
+ *---------------------------------------------------------------------------*/
+
+vf_encoding_t scan_name_field(
+    const char *p_string,       /* The name field */
+    uint32_t *p_bits,           /* Output VPQ_CHARSET & VPQ_ENCODING bits */
+    uint32_t *p_length          /* Output length of the field */
+    )
+{
+    vf_encoding_t ret = VF_ENC_7BIT;
+    uint32_t bits = 0;
+    uint32_t i;
+
+    for (i = 0;p_string[i];i++)
+    {
+        int match = TAG_NONE;
+
+        switch (TAG_UPPER(p_string[i]))
+        {
+        case 'E':
+            match = match_tag(p_string + i, VFP_ENCODING);
+            break;
+
+        case 'Q':
+            match = match_tag(p_string + i, VFP_QUOTEDPRINTABLE);
+
+            if (TAG_EXACT == match)
+            {
+                ret = VF_ENC_QUOTEDPRINTABLE;
+            }
+            break;
+
+        case 'B':
+            match = match_tag(p_string + i, VFP_BASE64);
+
+            if ((TAG_EXACT == match) && (VF_ENC_QUOTEDPRINTABLE != ret))
+            {
+                ret = VF_ENC_BASE64;
+            }
+            break;
+
+        case '8':
+            match = match_tag(p_string + i, VFP_8BIT);
+
+            if ((TAG_EXACT == match) && (VF_ENC_7BIT == ret))
+            {
+                ret = VF_ENC_8BIT;
+            }
+            break;
+
+        case '7':
+            match = match_tag(p_string + i, VFP_7BIT);
+            break;
+
+        case 'C':
+            if (TAG_EXACT == match_tag(p_string + i, VFP_CHARSET))
+            {
+                bits |= VPQ_CHARSET;
+            }
+            break;
+
+        default:
+            break;
+        }
+
+        if (TAG_NONE != match)
+        {
+            bits |= VPQ_ENCODING;
+        }
+    }
+
+    *p_bits = bits;
+    *p_length = i;
+
+    return ret;
+}
+
+/*---------------------------------------------------------------------------*
+ * NAME
+ *      match_tag()
+ * 
+ * DESCRIPTION
+ *      Check for a tag at the start of some characters.
+ *
+ * RETURNS
+ *      TAG_EXACT, TAG_NOCASE if it's there in another case, TAG_NONE else.
+ *---------------------------------------------------------------------------*/
+
+int match_tag(
+    const char *p_chars,        /* Where the tag might start */
+    const char *p_tag           /* The tag */
+    )
+{
+    int ret = TAG_EXACT;
+    uint32_t i;
+
+    for (i = 0;p_tag[i];i++)
+    {
+        if (p_chars[i] != p_tag[i])
+        {
+            if (TAG_UPPER(p_chars[i]) != p_tag[i])
+            {
+                return TAG_NONE;
+            }
+
+            ret = TAG_NOCASE;
+        }
+    }
+
+    return ret;
+}
+
 /*===========================================================================*
  End Of File
  *===========================================================================*/
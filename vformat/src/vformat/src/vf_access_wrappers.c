@@ -111,6 +111,8 @@ static const char vf_access_wrappers_c_vss_id[] = "$Header: /cvsroot/vformat/src
 #include "vf_internals.h"
 #include "vf_strings.h"
 #include "vf_string_arrays.h"
+#include "vf_arena.h"
+#include "vf_atoms.h"
 
 /*===========================================================================*
  Public Data
@@ -167,7 +169,7 @@ char *vf_get_prop_value_string(
     VPROP_T *p_vprop = (VPROP_T *)p_prop;
     char *p_ret = NULL;
 
-    if (p_vprop->value.v.s.pp_strings)
+    if (decode_lazy_value(p_vprop) && p_vprop->value.v.s.pp_strings)
     {      
         if (n_string < p_vprop->value.v.s.n_strings)
         {
@@ -220,11 +222,14 @@ const uint8_t *vf_get_prop_value_base64(
     {
         VPROP_T *p_vprop = (VPROP_T *)p_prop;
 
-        p_return = (uint8_t *)p_vprop->value.v.b.p_buffer;
-
-        if (p_length)
+        if (decode_lazy_value(p_vprop))
         {
-            *p_length = p_vprop->value.v.b.n_bufsize;
+            p_return = (uint8_t *)p_vprop->value.v.b.p_buffer;
+
+            if (p_length)
+            {
+                *p_length = p_vprop->value.v.b.n_bufsize;
+            }
         }
     }
 
@@ -301,9 +306,18 @@ bool_t vf_set_prop_value_object(
      */
     if (p_prop && p_object && !vf_prop_belongs_to_object(p_prop, p_object))
     {
+        VOBJECT_T *p_vobject = (VOBJECT_T *)p_object;
+
         delete_prop_contents(p_prop, FALSE);
-        
-        p_vprop->value.v.o.p_object = (VOBJECT_T *)p_object;
+
+        if (!p_vobject->p_parent || (p_vobject->p_arena != prop_arena(p_vprop)))
+        {
+            /* Not a sub-object allocated alongside the property */
+
+            arena_note_heap_use(p_vprop);
+        }
+
+        p_vprop->value.v.o.p_object = p_vobject;
         p_vprop->value.encoding = VF_ENC_VOBJECT;
 
         ret = TRUE;
@@ -366,6 +380,8 @@ bool_t vf_set_prop_name_string(
 
     if (p_vprop)
     {
+        arena_note_heap_use(p_vprop);
+
         if ((-1) == n_string)
         {
             ret = add_string_to_array(&p_vprop->name, p_string);
@@ -374,6 +390,8 @@ bool_t vf_set_prop_name_string(
         {
             ret = set_string_array_entry(&p_vprop->name, p_string, n_string);
         }
+
+        classify_prop_name(p_vprop);
     }
 
     return TRUE;
@@ -401,6 +419,10 @@ bool_t vf_set_prop_name_string(
  *      is set to "TIME" and the function returns *p_qualifier_index=2.
  *      pp_possible_values is set to NULL in this case.
  *
+ *      A well known token ("HOME", "FAX" etc.) is checked against the
+ *      property's VPQ_ bits first, so we only search the name fields when
+ *      it's there & we need its index.
+ *
  * RETURNS
  *      TRUE iff found, FALSE else.
  *---------------------------------------------------------------------------*/
@@ -415,9 +437,31 @@ bool_t vf_find_prop_qual_index(
 {
     uint32_t n;
     bool_t ret;
+    const char *p_token_atom = NULL;
 
     VPROP_T *p_vprop = (VPROP_T *)p_prop;
 
+    /*
+     * A well known token's bit says whether there's anything to find.
+     */
+    if (!pp_possible_values && p_token)
+    {
+        p_token_atom = atom_find(p_token, p_strlen(p_token), FALSE);
+
+        if (p_token_atom && (atom_qualifier(p_token_atom) & VPQ_TYPES))
+        {
+            if (!(p_vprop->qualifiers & atom_qualifier(p_token_atom)))
+            {
+                return FALSE;
+            }
+
+            if (!p_qualifier_index)
+            {
+                return TRUE;
+            }
+        }
+    }
+
     for (n = 0, ret = FALSE;!ret && (n < p_vprop->name.n_strings);n++)
     {
         const char *p_string = p_vprop->name.pp_strings[n];
@@ -444,7 +488,7 @@ bool_t vf_find_prop_qual_index(
             else
             if (!pp_possible_values && p_token)
             {
-                if (0 == p_stricmp(p_token, p_string))
+                if (ATOM_MATCH(p_string, p_token, p_token_atom))
                 {
                     if (p_qualifier_index)
                         *p_qualifier_index = n;
@@ -523,7 +567,8 @@ VFORMATDECLSPEC bool_t vf_find_property_qualifier_value(
  *      vf_find_charset()
  * 
  * DESCRIPTION
- *      Locate the charset 
+ *      Locate the charset, classify_prop_name() has already found the name
+ *      field holding it.
  *
  * RETURNS
  *      vf_charset_t.
@@ -533,9 +578,13 @@ const char *vf_find_charset(
     VF_PROP_T *p_prop
     )
 {
-    const char *p_value;
+    VPROP_T *p_vprop = (VPROP_T *)p_prop;
+    const char *p_value = NULL;
 
-    vf_find_property_qualifier_value(p_prop, NULL, &p_value, VFP_CHARSET);
+    if (p_vprop && p_vprop->n_charset)
+    {
+        p_value = p_vprop->name.pp_strings[p_vprop->n_charset - 1] + 1 + p_strlen(VFP_CHARSET);
+    }
 
     return p_value;
 }
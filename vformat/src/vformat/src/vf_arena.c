@@ -0,0 +1,664 @@
+/*******************************************************************************
+
+    (C) Nick Marley, 2001 -
+
+    This software is distributed under the GNU Lesser General Public Licence.
+    Please read and understand the comments at the top of vf_iface.h before use!
+
+FILE
+    $Workfile$
+    $Revision$
+    $Author$
+
+ORIGINAL AUTHOR
+    Nick Marley
+
+DESCRIPTION
+    Arena (bump pointer) allocation for object trees.  A tree bound to an
+    arena is built from a handful of large blocks and released in one go.
+
+REFERENCES
+    (none)
+
+MODIFICATION HISTORY
+ *  $Log$
+ *
+ *******************************************************************************/
+
+#ifndef NORCSID
+static const char vf_arena_c_vss_id[] = "$Header$";
+#endif
+
+/*=============================================================================*
+ ANSI C & System-wide Header Files
+ *=============================================================================*/
+
+#include <common/types.h>
+
+/*============================================================================*
+ Interface Header Files
+ *============================================================================*/
+
+#include "vformat/vf_iface.h"
+
+/*============================================================================*
+ Local Header File
+ *============================================================================*/
+
+#include "vf_config.h"
+#include "vf_malloc.h"
+#include "vf_internals.h"
+#include "vf_strings.h"
+#include "vf_string_arrays.h"
+#include "vf_arena.h"
+
+/*============================================================================*
+ Public Data
+ *============================================================================*/
+/* None */
+
+/*============================================================================*
+ Private Defines
+ *============================================================================*/
+
+/*
+ * Size of the first block if no hint is given, and the size beyond which
+ * blocks stop doubling.
+ */
+#if !defined(VFARENABLOCKSIZE)
+#define VFARENABLOCKSIZE            (4096)
+#endif
+
+#if !defined(VFARENAMAXBLOCKSIZE)
+#define VFARENAMAXBLOCKSIZE         (0x100000)
+#endif
+
+/*
+ * Alignment of memory handed out by arena_alloc().
+ */
+#define ARENA_ALIGN                 (sizeof(void *))
+
+#define ARENA_BLOCK_DATA(p_block)   ((char *)((p_block) + 1))
+
+/*============================================================================*
+ Private Data Types
+ *============================================================================*/
+/* None */
+
+/*============================================================================*
+ Private Function Prototypes
+ *============================================================================*/
+
+static void *alloc_from_blocks(
+    VARENA_T *p_arena,          /* The arena */
+    uint32_t size,              /* Bytes required */
+    uint32_t align              /* Alignment required */
+    );
+
+static bool_t add_block(
+    VARENA_T *p_arena,          /* The arena */
+    uint32_t size               /* Minimum bytes required */
+    );
+
+static bool_t arena_owns(
+    VARENA_T *p_arena,          /* The arena */
+    const void *p_memory        /* Memory to check */
+    );
+
+static void arena_release(
+    VARENA_T *p_arena           /* The arena */
+    );
+
+static bool_t adopt_string_array(
+    VARENA_T *p_arena,          /* The arena */
+    VSTRARRAY_T *p_dst,         /* Array in the arena */
+    VSTRARRAY_T *p_src          /* Array to move */
+    );
+
+/*============================================================================*
+ Private Data
+ *============================================================================*/
+/* None */
+
+/*============================================================================*
+ Public Function Implementations
+ *============================================================================*/
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      arena_create()
+ *
+ * DESCRIPTION
+ *      Allocate an arena holding a single reference.  size_hint gives the
+ *      size of the first block, zero selects a default.
+ *
+ * RETURNS
+ *      Pointer to the arena, NULL if allocation failed.
+ *----------------------------------------------------------------------------*/
+
+VARENA_T *arena_create(
+    uint32_t size_hint          /* Expected size of the tree, 0 if not known */
+    )
+{
+    VARENA_T *p_arena = (VARENA_T *)vf_malloc(sizeof(VARENA_T));
+
+    if (p_arena)
+    {
+        p_memset(p_arena, '\0', sizeof(VARENA_T));
+
+        p_arena->n_refs = 1;
+
+        if (!add_block(p_arena, size_hint ? size_hint : VFARENABLOCKSIZE))
+        {
+            vf_free(p_arena);
+            p_arena = NULL;
+        }
+    }
+
+    return p_arena;
+}
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      arena_alloc()
+ *
+ * DESCRIPTION
+ *      Allocate pointer aligned memory from the arena.
+ *
+ * RETURNS
+ *      Pointer to the memory, NULL if allocation failed.
+ *----------------------------------------------------------------------------*/
+
+void *arena_alloc(
+    VARENA_T *p_arena,          /* The arena */
+    uint32_t size               /* Bytes required */
+    )
+{
+    return alloc_from_blocks(p_arena, size, ARENA_ALIGN);
+}
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      arena_strdup()
+ *
+ * DESCRIPTION
+ *      Copy a string into the arena.
+ *
+ * RETURNS
+ *      Pointer to the copy, NULL if allocation failed.
+ *----------------------------------------------------------------------------*/
+
+char *arena_strdup(
+    VARENA_T *p_arena,          /* The arena */
+    const char *p_string        /* String to copy */
+    )
+{
+    uint32_t len = p_strlen(p_string);
+    char *p_copy = (char *)alloc_from_blocks(p_arena, 1 + len, 1);
+
+    if (p_copy)
+    {
+        p_memcpy(p_copy, p_string, 1 + len);
+    }
+
+    return p_copy;
+}
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      arena_free()
+ *
+ * DESCRIPTION
+ *      Free memory which may or may not have come from the arena.  Arena
+ *      memory is left alone (it goes when the arena goes), anything else is
+ *      returned to the heap.
+ *
+ * RETURNS
+ *      (none)
+ *----------------------------------------------------------------------------*/
+
+void arena_free(
+    VARENA_T *p_arena,          /* The arena, NULL => heap */
+    void *p_memory              /* Memory to free */
+    )
+{
+    if (p_memory && !arena_owns(p_arena, p_memory))
+    {
+        vf_free(p_memory);
+    }
+}
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      arena_drop_ref()
+ *
+ * DESCRIPTION
+ *      Drop a reference on the arena, releasing all of its memory when the
+ *      last one goes.
+ *
+ * RETURNS
+ *      (none)
+ *----------------------------------------------------------------------------*/
+
+void arena_drop_ref(
+    VARENA_T *p_arena           /* The arena */
+    )
+{
+    if (p_arena && (0 == --(p_arena->n_refs)))
+    {
+        arena_release(p_arena);
+    }
+}
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      arena_release_chain()
+ *
+ * DESCRIPTION
+ *      If the run of top level objects at the start of the list p_object
+ *      which share its arena holds every reference on the arena and nothing
+ *      has been allocated from the heap for the tree, release the arena in
+ *      one go.  This is the O(1) (well, O(number of blocks)) alternative to
+ *      walking the tree.  A list joined up from several arenas, as built by
+ *      vf_parse_buffer_parallel(), is released one run at a time.
+ *
+ * RETURNS
+ *      TRUE <=> released, FALSE => the caller must walk the tree.
+ *----------------------------------------------------------------------------*/
+
+bool_t arena_release_chain(
+    VOBJECT_T *p_object,        /* First object in the list */
+    VOBJECT_T **pp_rest         /* Objects after those released */
+    )
+{
+    VARENA_T *p_arena = p_object->p_arena;
+    uint32_t n_roots = 0;
+    VOBJECT_T *p_tmp;
+
+    if (!p_arena || p_arena->heap_used || p_object->p_parent)
+    {
+        return FALSE;
+    }
+
+    for (p_tmp = p_object;p_tmp && (p_tmp->p_arena == p_arena);p_tmp = p_tmp->p_next)
+    {
+        if (p_tmp->p_parent)
+        {
+            return FALSE;
+        }
+
+        n_roots++;
+    }
+
+    if (n_roots != p_arena->n_refs)
+    {
+        /* Someone (probably the parser) still holds a reference */
+
+        return FALSE;
+    }
+
+    arena_release(p_arena);
+
+    *pp_rest = p_tmp;
+
+    return TRUE;
+}
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      arena_adopt_prop()
+ *
+ * DESCRIPTION
+ *      Move the contents (group, name & value strings, binary data) of a
+ *      heap property p_src into the arena property p_dst.  p_src is left
+ *      empty but keeps its slot arrays so that they can be re-used.
+ *
+ *      Strings copied into the arena are marked as views so the string
+ *      array code never tries to free them.  Only the first
+ *      VSTRARRAY_MAXVIEWS entries can be marked, anything beyond that is
+ *      handed over as it is & the arena is flagged as needing a walk to
+ *      free it.
+ *
+ *      Each part is moved in one go so, even if we run out of memory, both
+ *      properties are left in a state delete_prop_contents() can clean up.
+ *
+ * RETURNS
+ *      TRUE <=> allocation OK, FALSE else.
+ *----------------------------------------------------------------------------*/
+
+bool_t arena_adopt_prop(
+    VARENA_T *p_arena,          /* The arena */
+    VPROP_T *p_dst,             /* Property in the arena */
+    VPROP_T *p_src              /* Property to move */
+    )
+{
+    bool_t ok = TRUE;
+
+    if (p_src->p_group)
+    {
+        p_dst->p_group = arena_strdup(p_arena, p_src->p_group);
+
+        if (p_dst->p_group)
+        {
+            vf_free(p_src->p_group);
+            p_src->p_group = NULL;
+        }
+        else
+        {
+            ok = FALSE;
+        }
+    }
+
+    if (ok && p_src->value.v.b.p_buffer)
+    {
+        uint32_t n_bufsize = p_src->value.v.b.n_bufsize;
+
+        p_dst->value.v.b.p_buffer = (char *)alloc_from_blocks(p_arena, n_bufsize, 1);
+
+        if (p_dst->value.v.b.p_buffer)
+        {
+            p_memcpy(p_dst->value.v.b.p_buffer, p_src->value.v.b.p_buffer, n_bufsize);
+            p_dst->value.v.b.n_bufsize = n_bufsize;
+            p_dst->value.v.b.n_alloc = n_bufsize;
+
+            vf_free(p_src->value.v.b.p_buffer);
+            p_src->value.v.b.p_buffer = NULL;
+            p_src->value.v.b.n_bufsize = 0;
+            p_src->value.v.b.n_alloc = 0;
+        }
+        else
+        {
+            ok = FALSE;
+        }
+    }
+
+    if (ok)
+    {
+        ok = (bool_t)(adopt_string_array(p_arena, &(p_dst->name), &(p_src->name)) &&
+            adopt_string_array(p_arena, &(p_dst->value.v.s), &(p_src->value.v.s)));
+    }
+
+    return ok;
+}
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      arena_note_heap_use()
+ *
+ * DESCRIPTION
+ *      Called by the mutation APIs.  If the property belongs to an arena tree
+ *      note that the tree now holds heap memory.
+ *
+ * RETURNS
+ *      (none)
+ *----------------------------------------------------------------------------*/
+
+void arena_note_heap_use(
+    VPROP_T *p_prop             /* Property being modified */
+    )
+{
+    VARENA_T *p_arena = prop_arena(p_prop);
+
+    if (p_arena)
+    {
+        p_arena->heap_used = TRUE;
+    }
+}
+
+/*============================================================================*
+ Private Function Implementations
+ *============================================================================*/
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      alloc_from_blocks()
+ *
+ * DESCRIPTION
+ *      Carve memory out of the current block, adding a block if there's
+ *      no room.
+ *
+ * RETURNS
+ *      Pointer to the memory, NULL if allocation failed.
+ *----------------------------------------------------------------------------*/
+
+void *alloc_from_blocks(
+    VARENA_T *p_arena,          /* The arena */
+    uint32_t size,              /* Bytes required */
+    uint32_t align              /* Alignment required */
+    )
+{
+    VARENA_BLOCK_T *p_block = p_arena->p_blocks;
+    uint32_t offset = (p_block->used + align - 1) & ~(align - 1);
+
+    if (p_block->size < offset + size)
+    {
+        if (!add_block(p_arena, size))
+        {
+            return NULL;
+        }
+
+        p_block = p_arena->p_blocks;
+        offset = (p_block->used + align - 1) & ~(align - 1);
+
+        if (p_block->size < offset + size)
+        {
+            /* Big request got a block of its own, behind the current one */
+
+            p_block = p_block->p_next;
+            offset = 0;
+        }
+    }
+
+    p_block->used = offset + size;
+
+    return ARENA_BLOCK_DATA(p_block) + offset;
+}
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      add_block()
+ *
+ * DESCRIPTION
+ *      Add a block with room for at least size bytes.  Blocks double in size
+ *      up to VFARENAMAXBLOCKSIZE.  A request too big to share a block gets
+ *      one sized to fit, linked in behind the current block so that the
+ *      current block can go on being used.
+ *
+ * RETURNS
+ *      TRUE <=> allocation OK, FALSE else.
+ *----------------------------------------------------------------------------*/
+
+bool_t add_block(
+    VARENA_T *p_arena,          /* The arena */
+    uint32_t size               /* Minimum bytes required */
+    )
+{
+    VARENA_BLOCK_T *p_head = p_arena->p_blocks;
+    VARENA_BLOCK_T *p_block;
+    uint32_t blocksize = size;
+    bool_t dedicated = FALSE;
+
+    if (p_head)
+    {
+        blocksize = 2 * p_head->size;
+
+        if (VFARENAMAXBLOCKSIZE < blocksize)
+        {
+            blocksize = (VFARENAMAXBLOCKSIZE < p_head->size) ? p_head->size : VFARENAMAXBLOCKSIZE;
+        }
+
+        if (blocksize / 2 < size)
+        {
+            blocksize = size;
+            dedicated = TRUE;
+        }
+    }
+
+    p_block = (VARENA_BLOCK_T *)vf_malloc(sizeof(VARENA_BLOCK_T) + blocksize);
+
+    if (p_block)
+    {
+        p_block->size = blocksize;
+        p_block->used = 0;
+
+        if (dedicated)
+        {
+            p_block->p_next = p_head->p_next;
+            p_head->p_next = p_block;
+        }
+        else
+        {
+            p_block->p_next = p_head;
+            p_arena->p_blocks = p_block;
+        }
+    }
+
+    return (bool_t)(NULL != p_block);
+}
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      arena_owns()
+ *
+ * DESCRIPTION
+ *      Check whether memory was allocated from the arena.
+ *
+ * RETURNS
+ *      TRUE <=> arena memory, FALSE => heap.
+ *----------------------------------------------------------------------------*/
+
+bool_t arena_owns(
+    VARENA_T *p_arena,          /* The arena */
+    const void *p_memory        /* Memory to check */
+    )
+{
+    VARENA_BLOCK_T *p_block;
+
+    for (p_block = p_arena ? p_arena->p_blocks : NULL;p_block;p_block = p_block->p_next)
+    {
+        const char *p_data = ARENA_BLOCK_DATA(p_block);
+
+        if ((p_data <= (const char *)p_memory) && ((const char *)p_memory < p_data + p_block->size))
+        {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      arena_release()
+ *
+ * DESCRIPTION
+ *      Free all of the arena's blocks, and the arena.
+ *
+ * RETURNS
+ *      (none)
+ *----------------------------------------------------------------------------*/
+
+void arena_release(
+    VARENA_T *p_arena           /* The arena */
+    )
+{
+    VARENA_BLOCK_T *p_block = p_arena->p_blocks;
+
+    while (p_block)
+    {
+        VARENA_BLOCK_T *p_next = p_block->p_next;
+
+        vf_free(p_block);
+
+        p_block = p_next;
+    }
+
+    vf_free(p_arena);
+}
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      adopt_string_array()
+ *
+ * DESCRIPTION
+ *      Give the (empty) string array p_dst a slot array in the arena holding
+ *      the strings from p_src, copying heap strings into the arena too.
+ *      p_src is emptied but keeps its slot array.
+ *
+ * RETURNS
+ *      TRUE <=> allocation OK, FALSE else.
+ *----------------------------------------------------------------------------*/
+
+bool_t adopt_string_array(
+    VARENA_T *p_arena,          /* The arena */
+    VSTRARRAY_T *p_dst,         /* Array in the arena */
+    VSTRARRAY_T *p_src          /* Array to move */
+    )
+{
+    uint32_t i, n = p_src->n_strings;
+
+    if (n)
+    {
+        p_dst->pp_strings = (char **)arena_alloc(p_arena, n * sizeof(char *));
+
+        if (!p_dst->pp_strings)
+        {
+            return FALSE;
+        }
+
+        for (i = 0;i < n;i++)
+        {
+            char *p_string = p_src->pp_strings[i];
+
+            if (STRING_IS_VIEW(p_src, i))
+            {
+                p_dst->views |= ((uint32_t)1 << i);
+            }
+            else
+            if (p_string && (i < VSTRARRAY_MAXVIEWS))
+            {
+                char *p_copy = arena_strdup(p_arena, p_string);
+
+                if (p_copy)
+                {
+                    vf_free(p_string);
+
+                    p_string = p_copy;
+                    p_dst->views |= ((uint32_t)1 << i);
+                }
+                else
+                {
+                    p_arena->heap_used = TRUE;
+                }
+            }
+            else
+            if (p_string)
+            {
+                p_arena->heap_used = TRUE;
+            }
+
+            p_dst->pp_strings[i] = p_string;
+            p_src->pp_strings[i] = NULL;
+        }
+
+        p_dst->n_strings = n;
+        p_dst->n_alloc = n;
+        p_dst->shared_slots = TRUE;
+
+        /* Last entry is no longer being built up */
+
+        p_dst->n_curlen = p_dst->pp_strings[n - 1] ? p_strlen(p_dst->pp_strings[n - 1]) : 0;
+        p_dst->n_curalloc = 0;
+
+        p_src->n_strings = 0;
+        p_src->n_curlen = 0;
+        p_src->n_curalloc = 0;
+        p_src->views = 0;
+    }
+
+    return TRUE;
+}
+
+/*============================================================================*
+ End Of File
+ *============================================================================*/
@@ -0,0 +1,240 @@
+/*******************************************************************************
+
+    (C) Nick Marley, 2001 -
+
+    This software is distributed under the GNU Lesser General Public Licence.
+    Please read and understand the comments at the top of vf_iface.h before use!
+
+FILE
+    $Workfile$
+    $Revision$
+    $Author$
+
+ORIGINAL AUTHOR
+    Nick Marley
+
+DESCRIPTION
+    Library internal interface to the arena allocator used for object trees
+    created by vf_parse_init_arena() and vf_create_object_arena().
+
+REFERENCES
+    (none)
+
+MODIFICATION HISTORY
+ *  $Log$
+ *
+ *******************************************************************************/
+
+#ifndef INC_VF_ARENA_H
+#define INC_VF_ARENA_H
+
+#ifndef NORCSID
+static const char vf_arena_h_vss_id[] = "$Header$";
+#endif
+
+/*=============================================================================*
+ Public Includes
+ *============================================================================*/
+/* None */
+
+/*=============================================================================*
+ Public Defines
+ *============================================================================*/
+/* None */
+
+/*=============================================================================*
+ Public Types
+ *============================================================================*/
+
+/*----------------------------------------------------------------------------*
+ * PURPOSE
+ *      VARENA_BLOCK_T heads each chunk of memory in an arena, allocations are
+ *      made from the space following the header.
+ *----------------------------------------------------------------------------*/
+
+typedef struct VARENA_BLOCK_T
+{
+    struct VARENA_BLOCK_T   *p_next;        /* Next (older) block */
+    uint32_t                size;           /* Bytes available after the header */
+    uint32_t                used;           /* Bytes handed out */
+}
+VARENA_BLOCK_T;
+
+/*----------------------------------------------------------------------------*
+ * PURPOSE
+ *      VARENA_T is a bump pointer allocator.  Objects, properties and strings
+ *      are carved out of a few large blocks which are released together when
+ *      the last reference goes.  References are held by each top level object
+ *      in the arena and by the parser while it's running.
+ *
+ *      Anything attached to an arena tree by the mutation APIs is allocated
+ *      from the heap as usual, heap_used then tells us the tree has to be
+ *      walked to free it.
+ *----------------------------------------------------------------------------*/
+
+typedef struct VARENA_T
+{
+    VARENA_BLOCK_T      *p_blocks;          /* Most recent block first */
+    uint32_t            n_refs;             /* Top level objects + parser */
+    bool_t              heap_used;          /* Heap memory attached to the tree? */
+}
+VARENA_T;
+
+/*=============================================================================*
+ Public Functions
+ *============================================================================*/
+
+/*---------------------------------------------------------------------------*
+ * NAME
+ *      arena_create()
+ *
+ * DESCRIPTION
+ *      Allocate an arena holding a single reference.  size_hint gives the
+ *      size of the first block, zero selects a default.
+ *
+ * RETURNS
+ *      Pointer to the arena, NULL if allocation failed.
+ *---------------------------------------------------------------------------*/
+
+extern VARENA_T *arena_create(
+    uint32_t size_hint          /* Expected size of the tree, 0 if not known */
+    );
+
+/*---------------------------------------------------------------------------*
+ * NAME
+ *      arena_alloc()
+ *
+ * DESCRIPTION
+ *      Allocate pointer aligned memory from the arena.
+ *
+ * RETURNS
+ *      Pointer to the memory, NULL if allocation failed.
+ *---------------------------------------------------------------------------*/
+
+extern void *arena_alloc(
+    VARENA_T *p_arena,          /* The arena */
+    uint32_t size               /* Bytes required */
+    );
+
+/*---------------------------------------------------------------------------*
+ * NAME
+ *      arena_strdup()
+ *
+ * DESCRIPTION
+ *      Copy a string into the arena.
+ *
+ * RETURNS
+ *      Pointer to the copy, NULL if allocation failed.
+ *---------------------------------------------------------------------------*/
+
+extern char *arena_strdup(
+    VARENA_T *p_arena,          /* The arena */
+    const char *p_string        /* String to copy */
+    );
+
+/*---------------------------------------------------------------------------*
+ * NAME
+ *      arena_free()
+ *
+ * DESCRIPTION
+ *      Free memory which may or may not have come from the arena.  Arena
+ *      memory is left alone, anything else is returned to the heap.
+ *
+ * RETURNS
+ *      (none)
+ *---------------------------------------------------------------------------*/
+
+extern void arena_free(
+    VARENA_T *p_arena,          /* The arena, NULL => heap */
+    void *p_memory              /* Memory to free */
+    );
+
+/*---------------------------------------------------------------------------*
+ * NAME
+ *      arena_drop_ref()
+ *
+ * DESCRIPTION
+ *      Drop a reference on the arena, releasing all of its memory when the
+ *      last one goes.
+ *
+ * RETURNS
+ *      (none)
+ *---------------------------------------------------------------------------*/
+
+extern void arena_drop_ref(
+    VARENA_T *p_arena           /* The arena */
+    );
+
+/*---------------------------------------------------------------------------*
+ * NAME
+ *      arena_release_chain()
+ *
+ * DESCRIPTION
+ *      If the run of top level objects at the start of the list p_object
+ *      which share its arena holds every reference on the arena and nothing
+ *      has been allocated from the heap for the tree, release the arena in
+ *      one go.  *pp_rest is set to the rest of the list.
+ *
+ * RETURNS
+ *      TRUE <=> released, FALSE => the caller must walk the tree.
+ *---------------------------------------------------------------------------*/
+
+extern bool_t arena_release_chain(
+    VOBJECT_T *p_object,        /* First object in the list */
+    VOBJECT_T **pp_rest         /* Objects after those released */
+    );
+
+/*---------------------------------------------------------------------------*
+ * NAME
+ *      arena_adopt_prop()
+ *
+ * DESCRIPTION
+ *      Move the contents (group, name & value strings, binary data) of a
+ *      heap property into a property allocated from the arena.  The heap
+ *      property is left empty but keeps its slot arrays for re-use.
+ *
+ * RETURNS
+ *      TRUE <=> allocation OK, FALSE else.
+ *---------------------------------------------------------------------------*/
+
+extern bool_t arena_adopt_prop(
+    VARENA_T *p_arena,          /* The arena */
+    VPROP_T *p_dst,             /* Property in the arena */
+    VPROP_T *p_src              /* Property to move */
+    );
+
+/*---------------------------------------------------------------------------*
+ * NAME
+ *      arena_note_heap_use()
+ *
+ * DESCRIPTION
+ *      Called by the mutation APIs.  If the property belongs to an arena tree
+ *      note that the tree now holds heap memory.
+ *
+ * RETURNS
+ *      (none)
+ *---------------------------------------------------------------------------*/
+
+extern void arena_note_heap_use(
+    VPROP_T *p_prop             /* Property being modified */
+    );
+
+/*---------------------------------------------------------------------------*
+ * NAME
+ *      prop_arena()
+ *
+ * DESCRIPTION
+ *      Find the arena (if any) holding a property.
+ *
+ * RETURNS
+ *      Pointer to the arena, NULL => heap.
+ *---------------------------------------------------------------------------*/
+
+#define prop_arena(p_prop) \
+    ((p_prop)->p_parent ? (p_prop)->p_parent->p_arena : NULL)
+
+/*=============================================================================*
+ End of file
+ *============================================================================*/
+
+#endif /*INC_VF_ARENA_H*/
@@ -0,0 +1,198 @@
+/*******************************************************************************
+
+    (C) Nick Marley, 2001 -
+
+    This software is distributed under the GNU Lesser General Public Licence.
+    Please read and understand the comments at the top of vf_iface.h before use!
+
+FILE
+    $Workfile$
+    $Revision$
+    $Author$
+
+ORIGINAL AUTHOR
+    Nick Marley
+
+DESCRIPTION
+    Table of well known property name fields ("atoms") with a perfect hash
+    for looking them up.
+
+    The table holds the VFP_ strings from vf_iface.h, BEGIN & END, and the
+    common "ENCODING=" & "CHARSET=" parameters, each with the encoding and
+    the VPQ_ qualifier bits it stands for.  The hash is FNV-1a over the
+    upper cased field; the low bits pick a bucket in atom_disp[] whose
+    displacement is mixed in to pick a slot in atom_slot[].  Both tables are
+    generated from vf_atoms.def by vf_atoms_gen.c into vf_atoms_hash.h.
+
+REFERENCES
+    (none)
+
+MODIFICATION HISTORY
+ *  $Log$
+ *
+ *******************************************************************************/
+
+#ifndef NORCSID
+static const char vf_atoms_c_vss_id[] = "$Header$";
+#endif
+
+/*=============================================================================*
+ ANSI C & System-wide Header Files
+ *=============================================================================*/
+
+#include <common/types.h>
+
+/*============================================================================*
+ Interface Header Files
+ *============================================================================*/
+
+#include "vformat/vf_iface.h"
+
+/*============================================================================*
+ Local Header File
+ *============================================================================*/
+
+#include "vf_config.h"
+#include "vf_internals.h"
+#include "vf_strings.h"
+#include "vf_atoms.h"
+
+/*============================================================================*
+ Public Data
+ *============================================================================*/
+
+/*
+ * Built from vf_atoms.def.  atom_slot[] holds indices into this table, so the
+ * order must match the one vf_atoms_hash.h was generated from.
+ */
+#define ATOM(name, encoding, qualifier) \
+    { name, (uint8_t)(sizeof(name) - 1), encoding, qualifier },
+
+const VATOM_T atom_table[ATOM_COUNT] =
+{
+#include "vf_atoms.def"
+};
+
+#undef ATOM
+
+/*============================================================================*
+ Private Defines
+ *============================================================================*/
+
+/*
+ * Buckets in atom_disp[] and slots in atom_slot[] (as a power of two).
+ */
+#define ATOM_BUCKETS                (64)
+#define ATOM_SLOTBITS               (8)
+
+#define ATOM_NOSLOT                 (0xFF)
+
+#define ATOM_UPPER(c) \
+    ((('a' <= (c)) && ((c) <= 'z')) ? (uint8_t)((c) - 'a' + 'A') : (uint8_t)(c))
+
+/*============================================================================*
+ Private Data Types
+ *============================================================================*/
+/* None */
+
+/*============================================================================*
+ Private Function Prototypes
+ *============================================================================*/
+/* None */
+
+/*============================================================================*
+ Private Data
+ *============================================================================*/
+
+/*
+ * Displacement for each bucket and index in atom_table[] for each slot.
+ */
+#include "vf_atoms_hash.h"
+
+#if ATOM_GENERATED_COUNT != ATOM_COUNT
+#error vf_atoms_hash.h is out of date, regenerate it with vf_atoms_gen
+#endif
+
+/*
+ * Fails to compile if vf_atoms.def has more or fewer entries than ATOM_COUNT.
+ */
+#define ATOM(name, encoding, qualifier) + 1
+
+typedef char atom_count_check[(ATOM_COUNT == (0
+#include "vf_atoms.def"
+    )) ? 1 : -1];
+
+#undef ATOM
+
+/*============================================================================*
+ Public Function Implementations
+ *============================================================================*/
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      atom_find()
+ *
+ * DESCRIPTION
+ *      Look up a field in the atom table.  The parser wants an exact match so
+ *      that the text is written back as it was read, searches want a case
+ *      insensitive one.
+ *
+ * RETURNS
+ *      The atom's name, NULL if the field isn't an atom.
+ *----------------------------------------------------------------------------*/
+
+const char *atom_find(
+    const char *p_chars,        /* Field, need not be terminated */
+    uint32_t length,            /* Length of the field */
+    bool_t exact                /* Exact or case insensitive match */
+    )
+{
+    uint32_t h = 0x811C9DC5;
+    uint32_t i;
+    uint8_t index;
+    const VATOM_T *p_atom;
+
+    if (ATOM_NAMESIZE <= length)
+    {
+        return NULL;
+    }
+
+    for (i = 0;i < length;i++)
+    {
+        h = (h ^ ATOM_UPPER(p_chars[i])) * 0x01000193;
+    }
+
+    h ^= (uint32_t)atom_disp[h & (ATOM_BUCKETS - 1)] * 0x9E3779B1;
+    index = atom_slot[(h * 0x85EBCA6B) >> (32 - ATOM_SLOTBITS)];
+
+    if (ATOM_NOSLOT == index)
+    {
+        return NULL;
+    }
+
+    p_atom = &atom_table[index];
+
+    if (p_atom->length != length)
+    {
+        return NULL;
+    }
+
+    for (i = 0;i < length;i++)
+    {
+        if (exact ? (p_chars[i] != p_atom->name[i]) : (ATOM_UPPER(p_chars[i]) != (uint8_t)p_atom->name[i]))
+        {
+            return NULL;
+        }
+    }
+
+    return p_atom->name;
+}
+
+/*============================================================================*
+ Private Function Implementations
+ *============================================================================*/
+/* None */
+
+/*============================================================================*
+ End Of File
+ *============================================================================*/
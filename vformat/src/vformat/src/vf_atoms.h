@@ -0,0 +1,189 @@
+/*******************************************************************************
+
+    (C) Nick Marley, 2001 -
+
+    This software is distributed under the GNU Lesser General Public Licence.
+    Please read and understand the comments at the top of vf_iface.h before use!
+
+FILE
+    $Workfile$
+    $Revision$
+    $Author$
+
+ORIGINAL AUTHOR
+    Nick Marley
+
+DESCRIPTION
+    Library internal interface to the table of well known property name
+    fields ("atoms").
+
+    The parser stores a name field which exactly matches an atom as a view
+    onto the table instead of allocating a copy, so every "TEL", "WORK" etc.
+    in a file shares the same string.  An atom is identified by its address,
+    two atoms are the same field iff the pointers are equal.
+
+REFERENCES
+    (none)
+
+MODIFICATION HISTORY
+ *  $Log$
+ *
+ *******************************************************************************/
+
+#ifndef INC_VF_ATOMS_H
+#define INC_VF_ATOMS_H
+
+#ifndef NORCSID
+static const char vf_atoms_h_vss_id[] = "$Header$";
+#endif
+
+/*=============================================================================*
+ Public Includes
+ *============================================================================*/
+/* None */
+
+/*=============================================================================*
+ Public Defines
+ *============================================================================*/
+
+/*
+ * Number of entries in vf_atoms.def and room for the longest.
+ */
+#define ATOM_COUNT                  (180)
+#define ATOM_NAMESIZE               (26)
+
+/*
+ * Does a string belong to the atom table?
+ */
+#define IS_ATOM(p_string) \
+    (((const char *)(p_string) >= (const char *)atom_table) && \
+     ((const char *)(p_string) < (const char *)(atom_table + ATOM_COUNT)))
+
+/*
+ * Case insensitive comparison of a string against a tag, p_tag_atom being
+ * the result of atom_find(p_tag, .., FALSE).  Atoms are compared by address.
+ */
+#define ATOM_MATCH(p_string, p_tag, p_tag_atom) \
+    (IS_ATOM(p_string) ? ((const char *)(p_string) == (p_tag_atom)) : (0 == p_stricmp((p_string), (p_tag))))
+
+/*
+ * Qualifier bits, one for each of the well known TYPE values plus two marking
+ * fields which give a charset or an encoding.  See VPROP_T::qualifiers.
+ */
+#define VPQ_DOM                     ((uint32_t)0x00000001)
+#define VPQ_INTL                    ((uint32_t)0x00000002)
+#define VPQ_POSTAL                  ((uint32_t)0x00000004)
+#define VPQ_PARCEL                  ((uint32_t)0x00000008)
+#define VPQ_HOME                    ((uint32_t)0x00000010)
+#define VPQ_WORK                    ((uint32_t)0x00000020)
+#define VPQ_PREF                    ((uint32_t)0x00000040)
+#define VPQ_VOICE                   ((uint32_t)0x00000080)
+#define VPQ_FAX                     ((uint32_t)0x00000100)
+#define VPQ_MSG                     ((uint32_t)0x00000200)
+#define VPQ_CELL                    ((uint32_t)0x00000400)
+#define VPQ_PAGER                   ((uint32_t)0x00000800)
+#define VPQ_BBS                     ((uint32_t)0x00001000)
+#define VPQ_MODEM                   ((uint32_t)0x00002000)
+#define VPQ_CAR                     ((uint32_t)0x00004000)
+#define VPQ_ISDN                    ((uint32_t)0x00008000)
+#define VPQ_VIDEO                   ((uint32_t)0x00010000)
+#define VPQ_INTERNET                ((uint32_t)0x00020000)
+#define VPQ_X400                    ((uint32_t)0x00040000)
+#define VPQ_AOL                     ((uint32_t)0x00080000)
+#define VPQ_APPLELINK               ((uint32_t)0x00100000)
+#define VPQ_ATTMAIL                 ((uint32_t)0x00200000)
+#define VPQ_CIS                     ((uint32_t)0x00400000)
+#define VPQ_EWORLD                  ((uint32_t)0x00800000)
+#define VPQ_IBMMAIL                 ((uint32_t)0x01000000)
+#define VPQ_MCIMAIL                 ((uint32_t)0x02000000)
+#define VPQ_POWERSHARE              ((uint32_t)0x04000000)
+#define VPQ_PRODIGY                 ((uint32_t)0x08000000)
+#define VPQ_TLX                     ((uint32_t)0x10000000)
+
+#define VPQ_TYPES                   ((uint32_t)0x1FFFFFFF)
+
+#define VPQ_CHARSET                 ((uint32_t)0x40000000)
+#define VPQ_ENCODING                ((uint32_t)0x80000000)
+
+/*=============================================================================*
+ Public Types
+ *============================================================================*/
+
+/*----------------------------------------------------------------------------*
+ * PURPOSE
+ *      VATOM_T is an entry in the atom table.  The name comes first so that
+ *      a pointer to it is a pointer to the entry.
+ *----------------------------------------------------------------------------*/
+
+typedef struct VATOM_T
+{
+    char                name[ATOM_NAMESIZE];    /* The field, upper case */
+    uint8_t             length;                 /* p_strlen(name) */
+    vf_encoding_t       encoding;               /* Encoding implied by the field */
+    uint32_t            qualifier;              /* VPQ_ bits for the field */
+}
+VATOM_T;
+
+/*
+ * The table itself, see vf_atoms.c.
+ */
+extern const VATOM_T atom_table[ATOM_COUNT];
+
+/*=============================================================================*
+ Public Functions
+ *============================================================================*/
+
+/*---------------------------------------------------------------------------*
+ * NAME
+ *      atom_find()
+ *
+ * DESCRIPTION
+ *      Look up a field in the atom table.  The parser wants an exact match so
+ *      that the text is written back as it was read, searches want a case
+ *      insensitive one.
+ *
+ * RETURNS
+ *      The atom's name, NULL if the field isn't an atom.
+ *---------------------------------------------------------------------------*/
+
+extern const char *atom_find(
+    const char *p_chars,        /* Field, need not be terminated */
+    uint32_t length,            /* Length of the field */
+    bool_t exact                /* Exact or case insensitive match */
+    );
+
+/*---------------------------------------------------------------------------*
+ * NAME
+ *      atom_encoding()
+ *
+ * DESCRIPTION
+ *      Look up the encoding named by an atom, "QUOTED-PRINTABLE" or
+ *      "ENCODING=BASE64" for example.
+ *
+ * RETURNS
+ *      The encoding, VF_ENC_7BIT if the atom doesn't name one.
+ *---------------------------------------------------------------------------*/
+
+#define atom_encoding(p_atom) \
+    (((const VATOM_T *)(p_atom))->encoding)
+
+/*---------------------------------------------------------------------------*
+ * NAME
+ *      atom_qualifier()
+ *
+ * DESCRIPTION
+ *      Look up the VPQ_ bits for an atom, VPQ_HOME for "HOME" or VPQ_CHARSET
+ *      for "CHARSET=UTF-8" for example.
+ *
+ * RETURNS
+ *      The bits, zero if the atom isn't a well known qualifier.
+ *---------------------------------------------------------------------------*/
+
+#define atom_qualifier(p_atom) \
+    (((const VATOM_T *)(p_atom))->qualifier)
+
+/*=============================================================================*
+ End of file
+ *============================================================================*/
+
+#endif /*INC_VF_ATOMS_H*/
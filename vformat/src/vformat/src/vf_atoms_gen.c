@@ -0,0 +1,303 @@
+/*******************************************************************************
+
+    (C) Nick Marley, 2001 -
+
+    This software is distributed under the GNU Lesser General Public Licence.
+    Please read and understand the comments at the top of vf_iface.h before use!
+
+FILE
+    $Workfile$
+    $Revision$
+    $Author$
+
+ORIGINAL AUTHOR
+    Nick Marley
+
+DESCRIPTION
+    Build time generator for vf_atoms_hash.h, the perfect hash over the atoms
+    listed in vf_atoms.def.  Not part of the library; run it whenever
+    vf_atoms.def changes:
+
+        cc -o vf_atoms_gen vf_atoms_gen.c
+        ./vf_atoms_gen > vf_atoms_hash.h
+
+    Each atom's FNV-1a hash (of the upper cased field) picks one of
+    ATOM_BUCKETS buckets.  Buckets are taken in order of decreasing size and
+    for each the first displacement is found that sends all of its atoms to
+    free slots, atom_find() mixing the displacement in the same way.  The
+    slot table holds the atom's index in atom_table[], ie. its position in
+    vf_atoms.def.
+
+    Standard C only so that it builds on the host when cross compiling.
+
+REFERENCES
+    (none)
+
+MODIFICATION HISTORY
+ *  $Log$
+ *
+ *******************************************************************************/
+
+#ifndef NORCSID
+static const char vf_atoms_gen_c_vss_id[] = "$Header$";
+#endif
+
+/*=============================================================================*
+ ANSI C & System-wide Header Files
+ *=============================================================================*/
+
+#include <stdio.h>
+#include <string.h>
+
+/*============================================================================*
+ Private Defines
+ *============================================================================*/
+
+/*
+ * Must agree with vf_atoms.h and vf_atoms.c.
+ */
+#define ATOM_NAMESIZE               (26)
+#define ATOM_BUCKETS                (64)
+#define ATOM_SLOTBITS               (8)
+#define ATOM_SLOTS                  (1 << ATOM_SLOTBITS)
+#define ATOM_NOSLOT                 (0xFF)
+
+#define ATOM_UPPER(c) \
+    ((('a' <= (c)) && ((c) <= 'z')) ? (unsigned long)((c) - 'a' + 'A') : (unsigned long)(unsigned char)(c))
+
+#define U32(x)                      ((x) & 0xFFFFFFFFUL)
+
+/*============================================================================*
+ Private Data
+ *============================================================================*/
+
+/*
+ * Only the names are wanted here.
+ */
+#define ATOM(name, encoding, qualifier) name,
+
+static const char *atom_names[] =
+{
+#include "vf_atoms.def"
+};
+
+#undef ATOM
+
+#define ATOM_COUNT                  ((int)(sizeof(atom_names) / sizeof(atom_names[0])))
+
+static unsigned long atom_hash[sizeof(atom_names) / sizeof(atom_names[0])];
+
+static unsigned char disp[ATOM_BUCKETS];
+
+static unsigned char slot[ATOM_SLOTS];
+
+/*============================================================================*
+ Private Function Prototypes
+ *============================================================================*/
+
+static unsigned long slot_for(
+    unsigned long h,            /* FNV-1a hash of the atom */
+    unsigned int d              /* Displacement for its bucket */
+    );
+
+static int place_bucket(
+    int bucket                  /* Bucket to find a displacement for */
+    );
+
+static void print_table(
+    const char *p_decl,         /* Declaration of the table */
+    const unsigned char *p_table, /* Its contents */
+    int size                    /* Number of entries */
+    );
+
+/*============================================================================*
+ Public Function Implementations
+ *============================================================================*/
+
+int main(void)
+{
+    int sizes[ATOM_BUCKETS];
+    int i, j;
+
+    if (ATOM_NOSLOT <= ATOM_COUNT)
+    {
+        fprintf(stderr, "vf_atoms_gen: %d atoms, the slot table holds fewer than %d\n", ATOM_COUNT, ATOM_NOSLOT);
+        return 1;
+    }
+
+    memset(sizes, 0, sizeof(sizes));
+    memset(slot, ATOM_NOSLOT, sizeof(slot));
+
+    for (i = 0;i < ATOM_COUNT;i++)
+    {
+        const char *p_name = atom_names[i];
+        unsigned long h = 0x811C9DC5UL;
+
+        if (ATOM_NAMESIZE <= strlen(p_name))
+        {
+            fprintf(stderr, "vf_atoms_gen: \"%s\" is too long\n", p_name);
+            return 1;
+        }
+
+        for (j = 0;p_name[j];j++)
+        {
+            if (ATOM_UPPER(p_name[j]) != (unsigned long)(unsigned char)p_name[j])
+            {
+                fprintf(stderr, "vf_atoms_gen: \"%s\" isn't upper case\n", p_name);
+                return 1;
+            }
+
+            h = U32((h ^ ATOM_UPPER(p_name[j])) * 0x01000193UL);
+        }
+
+        atom_hash[i] = h;
+        sizes[h & (ATOM_BUCKETS - 1)]++;
+    }
+
+    /* Biggest buckets first, lowest numbered first among equals */
+
+    for (j = ATOM_COUNT;0 < j;j--)
+    {
+        for (i = 0;i < ATOM_BUCKETS;i++)
+        {
+            if ((sizes[i] == j) && !place_bucket(i))
+            {
+                fprintf(stderr, "vf_atoms_gen: no displacement for bucket %d\n", i);
+                return 1;
+            }
+        }
+    }
+
+    printf("/*\n");
+    printf(" * Generated by vf_atoms_gen from vf_atoms.def - do not edit.\n");
+    printf(" */\n\n");
+    printf("#define ATOM_GENERATED_COUNT        (%d)\n\n", ATOM_COUNT);
+    print_table("static const uint8_t atom_disp[ATOM_BUCKETS]", disp, ATOM_BUCKETS);
+    printf("\n");
+    print_table("static const uint8_t atom_slot[1 << ATOM_SLOTBITS]", slot, ATOM_SLOTS);
+
+    return 0;
+}
+
+/*============================================================================*
+ Private Function Implementations
+ *============================================================================*/
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      slot_for()
+ *
+ * DESCRIPTION
+ *      Mix a displacement into a hash and pick a slot, as atom_find() does.
+ *
+ * RETURNS
+ *      The slot.
+ *----------------------------------------------------------------------------*/
+
+unsigned long slot_for(
+    unsigned long h,            /* FNV-1a hash of the atom */
+    unsigned int d              /* Displacement for its bucket */
+    )
+{
+    h = U32(h ^ U32((unsigned long)d * 0x9E3779B1UL));
+
+    return U32(h * 0x85EBCA6BUL) >> (32 - ATOM_SLOTBITS);
+}
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      place_bucket()
+ *
+ * DESCRIPTION
+ *      Find the first displacement which puts every atom in the bucket in a
+ *      free slot of its own, and fill those slots in.
+ *
+ * RETURNS
+ *      1 <=> bucket placed, 0 else.
+ *----------------------------------------------------------------------------*/
+
+int place_bucket(
+    int bucket                  /* Bucket to find a displacement for */
+    )
+{
+    unsigned int d;
+    int i, j;
+
+    for (d = 0;d < 0x100;d++)
+    {
+        int ok = 1;
+
+        for (i = 0;ok && (i < ATOM_COUNT);i++)
+        {
+            if ((int)(atom_hash[i] & (ATOM_BUCKETS - 1)) == bucket)
+            {
+                unsigned long s = slot_for(atom_hash[i], d);
+
+                ok = (ATOM_NOSLOT == slot[s]);
+
+                for (j = 0;ok && (j < i);j++)
+                {
+                    if ((int)(atom_hash[j] & (ATOM_BUCKETS - 1)) == bucket)
+                    {
+                        ok = (slot_for(atom_hash[j], d) != s);
+                    }
+                }
+            }
+        }
+
+        if (ok)
+        {
+            for (i = 0;i < ATOM_COUNT;i++)
+            {
+                if ((int)(atom_hash[i] & (ATOM_BUCKETS - 1)) == bucket)
+                {
+                    slot[slot_for(atom_hash[i], d)] = (unsigned char)i;
+                }
+            }
+
+            disp[bucket] = (unsigned char)d;
+
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      print_table()
+ *
+ * DESCRIPTION
+ *      Write out a table of bytes, sixteen to a line.
+ *
+ * RETURNS
+ *      (none)
+ *----------------------------------------------------------------------------*/
+
+void print_table(
+    const char *p_decl,         /* Declaration of the table */
+    const unsigned char *p_table, /* Its contents */
+    int size                    /* Number of entries */
+    )
+{
+    int i;
+
+    printf("%s =\n{", p_decl);
+
+    for (i = 0;i < size;i++)
+    {
+        printf("%s0x%02X", (i % 16) ? ", " : "\n    ", p_table[i]);
+
+        if (i + 1 < size)
+        {
+            printf("%s", ((i % 16) == 15) ? "," : "");
+        }
+    }
+
+    printf("\n};\n");
+}
+
+/*============================================================================*
+ End Of File
+ *============================================================================*/
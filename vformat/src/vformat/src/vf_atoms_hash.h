@@ -0,0 +1,33 @@
+/*
+ * Generated by vf_atoms_gen from vf_atoms.def - do not edit.
+ */
+
+#define ATOM_GENERATED_COUNT        (180)
+
+static const uint8_t atom_disp[ATOM_BUCKETS] =
+{
+    0x01, 0x03, 0x02, 0x03, 0x00, 0x03, 0x01, 0x01, 0x00, 0x03, 0x03, 0x00, 0x0F, 0x00, 0x04, 0x08,
+    0x01, 0x07, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x00, 0x05, 0x02,
+    0x01, 0x00, 0x00, 0x07, 0x00, 0x0C, 0x01, 0x03, 0x00, 0x06, 0x00, 0x01, 0x01, 0x00, 0x04, 0x05,
+    0x00, 0x0B, 0x02, 0x04, 0x1C, 0x00, 0x00, 0x01, 0x08, 0x13, 0x07, 0x00, 0x01, 0x03, 0x03, 0x00
+};
+
+static const uint8_t atom_slot[1 << ATOM_SLOTBITS] =
+{
+    0xFF, 0x27, 0xFF, 0xFF, 0x3B, 0x28, 0xFF, 0x55, 0x45, 0x6E, 0x00, 0xFF, 0xA1, 0x0E, 0x08, 0x52,
+    0xA3, 0x61, 0xFF, 0xFF, 0xA2, 0xFF, 0xFF, 0x4A, 0x1A, 0x3F, 0xFF, 0xFF, 0xFF, 0x5E, 0x90, 0xFF,
+    0x5C, 0xFF, 0x30, 0x87, 0x02, 0x73, 0x69, 0x58, 0x3A, 0xFF, 0x86, 0xAF, 0xA6, 0x8B, 0xFF, 0x07,
+    0x18, 0xFF, 0x48, 0x32, 0xFF, 0xFF, 0xB3, 0x7F, 0xFF, 0x59, 0x8D, 0x03, 0xFF, 0x83, 0x3D, 0xFF,
+    0x57, 0xA4, 0x64, 0x5F, 0x14, 0x44, 0xFF, 0xFF, 0x81, 0xFF, 0x36, 0x9A, 0xFF, 0xFF, 0xFF, 0x94,
+    0xFF, 0xFF, 0xAC, 0x24, 0xFF, 0x70, 0x5D, 0xFF, 0xFF, 0x40, 0x89, 0xB1, 0xFF, 0xFF, 0x22, 0x62,
+    0x96, 0xFF, 0xFF, 0xFF, 0x9C, 0x97, 0x95, 0x5B, 0xFF, 0x71, 0xAE, 0xFF, 0x15, 0x76, 0xA8, 0xFF,
+    0xFF, 0x05, 0x2A, 0xAD, 0x63, 0x84, 0xFF, 0x77, 0xFF, 0x37, 0x42, 0x26, 0x06, 0x0C, 0x2B, 0xFF,
+    0x39, 0xFF, 0xFF, 0x7E, 0x35, 0x4E, 0x1D, 0x1C, 0x2E, 0xFF, 0x4B, 0x99, 0xFF, 0x17, 0x85, 0x6F,
+    0x0A, 0x80, 0x41, 0xFF, 0xFF, 0x82, 0x8F, 0x25, 0xA5, 0x04, 0x67, 0xFF, 0x2F, 0x2C, 0xA7, 0x74,
+    0x7B, 0x6C, 0x43, 0xAB, 0x92, 0xFF, 0x4C, 0x66, 0x2D, 0x31, 0xB2, 0x3E, 0x23, 0x34, 0xFF, 0x75,
+    0x7D, 0x79, 0xFF, 0x0B, 0x1E, 0xFF, 0xFF, 0x6B, 0x12, 0x21, 0x38, 0x60, 0xFF, 0xFF, 0x72, 0x51,
+    0xA0, 0x8A, 0xFF, 0xFF, 0x88, 0x7C, 0xFF, 0x1F, 0x54, 0x93, 0x53, 0xA9, 0xFF, 0x9B, 0xFF, 0x4D,
+    0x5A, 0xFF, 0xFF, 0x11, 0x1B, 0x7A, 0x01, 0xFF, 0x78, 0x50, 0x9E, 0x68, 0xAA, 0x6D, 0x6A, 0x09,
+    0x56, 0x65, 0x20, 0x49, 0x16, 0x4F, 0xFF, 0xFF, 0x8C, 0x9F, 0x0D, 0x3C, 0xFF, 0xFF, 0x47, 0x8E,
+    0x10, 0xFF, 0xB0, 0x91, 0xFF, 0x46, 0xFF, 0x19, 0x33, 0x13, 0x9D, 0x0F, 0xFF, 0x29, 0xFF, 0x98
+};
@@ -143,6 +143,7 @@ VF_OBJECT_T *vf_clone_object(
 
                     /* copy name fields */
                     new_props->name.n_strings = props->name.n_strings;
+                    new_props->name.n_alloc = props->name.n_strings;
                     new_props->name.pp_strings = vf_malloc(new_props->name.n_strings * sizeof(char*));
 
                     for (index = 0; index < props->name.n_strings; index++)
@@ -159,9 +160,15 @@ VF_OBJECT_T *vf_clone_object(
                             new_props->name.pp_strings[index] = NULL;
                     }
 
-                    /* copy value fields */
+                    new_props->qualifiers = props->qualifiers;
+                    new_props->n_charset = props->n_charset;
+                    new_props->n_encoding = props->n_encoding;
+
+                    /* copy value fields, decoded */
                     new_props->value.encoding = props->value.encoding;
 
+                    (void)decode_lazy_value(props);
+
                     switch (props->value.encoding)
                     {
                         case VF_ENC_VOBJECT:
@@ -176,6 +183,7 @@ VF_OBJECT_T *vf_clone_object(
                         case VF_ENC_QUOTEDPRINTABLE:
                         {
                             new_props->value.v.s.n_strings = props->value.v.s.n_strings;
+                            new_props->value.v.s.n_alloc = props->value.v.s.n_strings;
                             new_props->value.v.s.pp_strings = vf_malloc(props->value.v.s.n_strings * sizeof(char*));
 
                             for (index = 0; index < props->value.v.s.n_strings; index++)
@@ -198,6 +206,7 @@ VF_OBJECT_T *vf_clone_object(
                         case VF_ENC_BASE64:
                         {
                             new_props->value.v.b.n_bufsize = props->value.v.b.n_bufsize;
+                            new_props->value.v.b.n_alloc = props->value.v.b.n_bufsize;
 
                             if (props->value.v.b.p_buffer)
                             {
@@ -216,6 +225,7 @@ VF_OBJECT_T *vf_clone_object(
                 }
             }
 
+            new_object->p_last_prop = new_props;
             new_object->p_parent = (VOBJECT_T*)p_parent;
         }
     }
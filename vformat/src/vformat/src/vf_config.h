@@ -71,6 +71,48 @@ static const char vf_config_h_vss_id[] = "$Header: /cvsroot/vformat/src/vformat/
 /* #define HAVE_MEMCPY */
 /* #define HAVE_MEMSET */
 
+/*
+ * <unistd.h> gives read(), write() and fsync() everywhere but Windows, which
+ * has its own versions in <io.h>.
+ */
+#if !defined(WIN) && !defined(WIN32)
+#if !defined(HAS_UNISTD_H)
+#define HAS_UNISTD_H
+#endif
+#endif
+
+/*
+ * Defined if <sys/mman.h> is available, vf_read_file() then maps regular files
+ * rather than reading them through a small buffer.  On everywhere but Windows.
+ */
+#if !defined(WIN) && !defined(WIN32)
+#if !defined(HAS_SYS_MMAN_H)
+#define HAS_SYS_MMAN_H
+#endif
+#endif
+
+/*
+ * Defined if <sys/uio.h> is available, vf_write_fd() and vf_write_file() then
+ * gather text with writev() rather than copying all of it for write().  On
+ * everywhere but Windows.
+ */
+#if !defined(WIN) && !defined(WIN32)
+#if !defined(HAS_SYS_UIO_H)
+#define HAS_SYS_UIO_H
+#endif
+#endif
+
+/*
+ * Defined if POSIX threads are available, vf_parse_buffer_parallel() then
+ * parses slices of the buffer concurrently.  On everywhere but Windows, the
+ * library is linked with -lpthread.
+ */
+#if !defined(WIN) && !defined(WIN32)
+#if !defined(HAS_PTHREAD_H)
+#define HAS_PTHREAD_H
+#endif
+#endif
+
 /*=============================================================================*
  Public Types
  *============================================================================*/
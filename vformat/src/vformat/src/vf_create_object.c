@@ -77,6 +77,7 @@ static const char vf_create_object_c_vss_id[] = "$Header: /cvsroot/vformat/src/v
 #include "vf_internals.h"
 #include "vf_strings.h"
 #include "vf_string_arrays.h"
+#include "vf_arena.h"
 
 /*===========================================================================*
  Public Data
@@ -152,6 +153,82 @@ VF_OBJECT_T *vf_create_object(
     return (VF_OBJECT_T *)p_new;
 }
 
+/*---------------------------------------------------------------------------*
+ * NAME
+ *      vf_create_object_arena()
+ * 
+ * DESCRIPTION
+ *      Creates an empty vformat object in an arena.  A top level object gets
+ *      an arena of its own, others share their parent's.
+ *
+ * RETURNS
+ *      Ptr to object if created else NULL.
+ *---------------------------------------------------------------------------*/
+
+VF_OBJECT_T *vf_create_object_arena(
+    const char *p_type,             /* Type of object to create */
+    VF_OBJECT_T *p_parent,          /* Parent object if any */
+    uint32_t size_hint              /* Expected size of the tree, 0 if unknown */
+    )
+{
+    VOBJECT_T *p_new = NULL;
+    VARENA_T *p_arena;
+
+    if (!p_type)
+    {
+        /* Nothing to do */
+    }
+    else
+    if (p_parent)
+    {
+        p_arena = ((VOBJECT_T *)p_parent)->p_arena;
+
+        if (p_arena)
+        {
+            p_new = (VOBJECT_T *)arena_alloc(p_arena, sizeof(VOBJECT_T));
+        }
+        else
+        {
+            return vf_create_object(p_type, p_parent);
+        }
+    }
+    else
+    {
+        p_arena = arena_create(size_hint);
+
+        if (p_arena)
+        {
+            p_new = (VOBJECT_T *)arena_alloc(p_arena, sizeof(VOBJECT_T));
+
+            if (!p_new)
+            {
+                arena_drop_ref(p_arena);
+            }
+        }
+    }
+
+    if (p_new)
+    {
+        p_memset(p_new, '\0', sizeof(VOBJECT_T));
+
+        p_new->p_type = arena_strdup(p_arena, p_type);
+        p_new->p_parent = (VOBJECT_T *)p_parent;
+        p_new->p_arena = p_arena;
+
+        if (!p_new->p_type)
+        {
+            if (!p_parent)
+            {
+                arena_drop_ref(p_arena);
+            }
+
+            p_new = NULL;
+        }
+    }
+
+    return (VF_OBJECT_T *)p_new;
+}
+
 /*===========================================================================*
  Private Function Implementations
  *===========================================================================*/
@@ -89,6 +89,8 @@ static const char vf_delete_c_vss_id[] = "$Header: /cvsroot/vformat/src/vformat/
 #include "vf_malloc.h"
 #include "vf_internals.h"
 #include "vf_string_arrays.h"
+#include "vf_arena.h"
+#include "vf_modified.h"
 
 /*============================================================================*
  Public Data
@@ -127,7 +129,9 @@ static void free_prop_list(
  *      vf_delete_object()
  * 
  * DESCRIPTION
- *      Cleans up the memory used by the indicated vformat object.
+ *      Cleans up the memory used by the indicated vformat object.  A list of
+ *      objects parsed into an arena is released in one go, unless the tree
+ *      has had heap memory attached to it, in which case we walk it.
  *
  * RETURNS
  *      (none)
@@ -140,18 +144,38 @@ void vf_delete_object(
 {
     VOBJECT_T *p_obj = (VOBJECT_T *)p_object;
     
+    while (p_obj && all && arena_release_chain(p_obj, &p_obj))
+    {
+        /* Run of the list in one arena, now gone */
+    }
+
     if (p_obj)
     {
         VOBJECT_T *p_next = p_obj->p_next;
+        VARENA_T *p_root_arena = p_obj->p_parent ? NULL : p_obj->p_arena;
 
         free_prop_list(p_obj->p_props);
 
-        if (p_obj->p_type)
+        if (p_obj->p_arena)
         {
-            vf_free(p_obj->p_type);
+            /* Freed with the arena */
         }
+        else
+        {
+            if (p_obj->p_type)
+            {
+                vf_free(p_obj->p_type);
+            }
 
-        vf_free(p_obj);
+            vf_free(p_obj);
+        }
+
+        if (p_root_arena)
+        {
+            /* Top level objects each hold a reference on the arena */
+
+            arena_drop_ref(p_root_arena);
+        }
 
         if (all )
         {
@@ -183,6 +207,7 @@ void vf_delete_prop(
     if (p_obj)
     {
         VPROP_T **p_vprop = &(p_obj->p_props);
+        VPROP_T *p_prev = NULL;
 
         while (*p_vprop)
         {
@@ -190,17 +215,27 @@ void vf_delete_prop(
             {
                 *p_vprop = ((VPROP_T *)p_prop)->p_next;
 
+                if (p_obj->p_last_prop == (VPROP_T *)p_prop)
+                {
+                    p_obj->p_last_prop = p_prev;
+                }
+
+                /* The object's lost a property */
+
+                mark_property_modified((VPROP_T *)p_prop, TRUE);
+
                 if (dc)
                 {
                     delete_prop_contents(p_prop, TRUE);
                 }
 
-                vf_free(p_prop);
+                arena_free(p_obj->p_arena, p_prop);
 
                 break;
             }
             else
             {
+                p_prev = *p_vprop;
                 p_vprop = &((*p_vprop)->p_next);
             }
         }
@@ -225,42 +260,34 @@ void delete_prop_contents(
     )
 {
     VPROP_T *p_prop = (VPROP_T *)p_vprop;
+    VARENA_T *p_arena = prop_arena(p_prop);
 
     if (delname)
     {
         free_string_array_contents(&p_prop->name);
 
+        p_prop->qualifiers = 0;
+        p_prop->n_charset = 0;
+        p_prop->n_encoding = 0;
+
         if (p_prop->p_group)
         {
-            vf_free(p_prop->p_group);
+            arena_free(p_arena, p_prop->p_group);
             p_prop->p_group = NULL;
         }
     }
 
     if (p_prop->value.v.b.p_buffer)
     {
-        vf_free(p_prop->value.v.b.p_buffer);
+        arena_free(p_arena, p_prop->value.v.b.p_buffer);
         p_prop->value.v.b.p_buffer = NULL;
+        p_prop->value.v.b.n_bufsize = 0;
+        p_prop->value.v.b.n_alloc = 0;
     }
 
-    if (p_prop->value.v.s.pp_strings)
-    {
-        uint32_t n;
-
-        for (n = 0;n < p_prop->value.v.s.n_strings;n++)
-        {
-            if (p_prop->value.v.s.pp_strings[n])
-            {
-                vf_free(p_prop->value.v.s.pp_strings[n]);
-                p_prop->value.v.s.pp_strings[n] = NULL;
-            }
-        }
-
-        vf_free(p_prop->value.v.s.pp_strings);
-        p_prop->value.v.s.pp_strings = NULL;
+    p_prop->value.lazy = FALSE;
 
-        p_prop->value.v.s.n_strings = 0;
-    }
+    free_string_array_contents(&p_prop->value.v.s);
 
     if (p_prop->value.v.o.p_object)
     {
@@ -296,7 +323,7 @@ void free_prop_list(
 
         delete_prop_contents((VF_PROP_T *)p_tmp, TRUE);
 
-        vf_free(p_tmp);
+        arena_free(prop_arena(p_tmp), p_tmp);
 
         p_tmp = p_next;
     }
@@ -87,6 +87,13 @@ static const char vf_internals_h_vss_id[] = "$Header: /cvsroot/vformat/src/vform
 #define VFP_BEGIN       "BEGIN"
 #define VFP_END         "END"
 
+/*
+ * Writer flag for internal use, the public VFWF_ flags count up from the
+ * bottom.  The writer stops after the top level object it's given instead
+ * of carrying on down the list, see vf_write_parallel().
+ */
+#define VFWF_ONEOBJECT  ((vf_write_flags_t)0x8000)
+
 /*=============================================================================*
  Public Types
  *============================================================================*/
@@ -100,6 +107,18 @@ typedef struct VSTRARRAY_T
 {
     uint32_t            n_strings;          /* Then number of strings */
     char                **pp_strings;       /* The strings */
+    uint32_t            n_alloc;            /* Slots allocated in pp_strings */
+
+    /*
+     * Length and allocated size of the last string, while it's being built
+     * up by append_to_curr_string().  n_curalloc of zero means "not known",
+     * it must be reset by anyone replacing the last string.
+     */
+    uint32_t            n_curlen;
+    uint32_t            n_curalloc;
+
+    uint32_t            views;              /* Entries not owned, see STRING_IS_VIEW() */
+    bool_t              shared_slots;       /* pp_strings not owned (arena) */
 }
 VSTRARRAY_T;
 
@@ -114,6 +133,7 @@ typedef struct VBINDATA_T
 {
     char                *p_buffer;          /* Binary data */
     uint32_t            n_bufsize;
+    uint32_t            n_alloc;            /* Bytes allocated in p_buffer */
 }
 VBINDATA_T;
 
@@ -136,6 +156,7 @@ VOBJDATA_T;
 typedef struct VPROPVALUE_T
 {
     vf_encoding_t   encoding;
+    bool_t          lazy;               /* v.b holds the text as read, see decode_lazy_value() */
 
     struct
     {
@@ -151,13 +172,17 @@ VPROPVALUE_T;
  * PURPOSE
  *      VPROP_T defines a single property.  It's an association of a name
  *      and value pair.  A vformat object is simply a list of properties.
- *      Associated with a property is (possibly) a group name.
+ *      Associated with a property is (possibly) a group name.  The
+ *      qualifiers etc. summarise the name, see classify_prop_name().
  *----------------------------------------------------------------------------*/
 
 typedef struct VPROP_T
 {
     char                *p_group;       /* Group - we keep the A.B.C format */
     VSTRARRAY_T         name;           /* Name fields */
+    uint32_t            qualifiers;     /* VPQ_ bits for the name fields */
+    uint32_t            n_charset;      /* 1 + index of the charset name field, 0 if none */
+    uint32_t            n_encoding;     /* 1 + index of the encoding name field, 0 if none */
     VPROPVALUE_T        value;          /* Value fields */
 
     struct VPROP_T      *p_next;        /* Next property */
@@ -178,14 +203,31 @@ typedef struct VOBJECT_T
 {
     char                *p_type;        /* "VCARD" or "VCALENDAR" etc. */
     VPROP_T             *p_props;       /* List of properties */
+    VPROP_T             *p_last_prop;   /* Last property, NULL => walk p_props */
 
     bool_t              modified;       /* Object modified? */
 
     struct VOBJECT_T    *p_parent;      /* Owning object (if any) */
     struct VOBJECT_T    *p_next;        /* Next object (if any) */
+
+    struct VARENA_T     *p_arena;       /* Arena holding the tree (if any) */
 }
 VOBJECT_T;
 
+/*----------------------------------------------------------------------------*
+ * PURPOSE
+ *      Takes text from a writer as it's generated, see vf_write_to_sink().
+ *      Stable text belongs to the object being written so stays put till
+ *      the write is finished, anything else must be copied before returning.
+ *----------------------------------------------------------------------------*/
+
+typedef bool_t (*vf_write_sink_t)(
+    void *p_context,            /* Sink context */
+    const char *p_chars,        /* The text */
+    uint32_t numchars,          /* Number of characters */
+    bool_t stable               /* Text stays put till the write's done? */
+    );
+
 /*=============================================================================*
  Public Functions
  *============================================================================*/
@@ -207,6 +249,136 @@ extern void delete_prop_contents(
     bool_t delname              /* Delete the name as well? */
     );
 
+/*---------------------------------------------------------------------------*
+ * NAME
+ *      classify_prop_name()
+ * 
+ * DESCRIPTION
+ *      Work out the qualifiers, n_charset & n_encoding fields of a property
+ *      from its name fields.  Anything changing the name calls this so that
+ *      lookups can test bits rather than search the strings.
+ *
+ * RETURNS
+ *      The encoding the name fields ask for.
+ *---------------------------------------------------------------------------*/
+
+extern vf_encoding_t classify_prop_name(
+    VPROP_T *p_prop             /* The property */
+    );
+
+/*---------------------------------------------------------------------------*
+ * NAME
+ *      decode_lazy_value()
+ * 
+ * DESCRIPTION
+ *      Decode a value left encoded by a VFPF_LAZYDECODE parse.  Anything
+ *      reading a value's strings or binary data calls this first, it does
+ *      nothing if the value has already been decoded.
+ *
+ * RETURNS
+ *      TRUE <=> allocation & syntax OK, FALSE else.
+ *---------------------------------------------------------------------------*/
+
+extern bool_t decode_lazy_value(
+    VPROP_T *p_prop             /* The property */
+    );
+
+/*---------------------------------------------------------------------------*
+ * NAME
+ *      lazy_value_verbatim()
+ * 
+ * DESCRIPTION
+ *      Check whether a value left encoded by VFPF_LAZYDECODE is exactly the
+ *      text the writer would produce by encoding it again, in which case it
+ *      can be written out as it is.  Only BASE64 values ever are.
+ *
+ * RETURNS
+ *      TRUE <=> value can be written out verbatim, FALSE else.
+ *---------------------------------------------------------------------------*/
+
+extern bool_t lazy_value_verbatim(
+    const VPROP_T *p_prop       /* The property */
+    );
+
+/*---------------------------------------------------------------------------*
+ * NAME
+ *      parse_end_at_top_level()
+ * 
+ * DESCRIPTION
+ *      As vf_parse_end(), for a parser which has been given a slice of a
+ *      larger buffer.  Also reports whether the slice ended between top
+ *      level objects, ie. whether a new parser started on the text after
+ *      it builds the same objects as this one would carrying on, provided
+ *      that text starts a line with a property name.
+ *
+ * RETURNS
+ *      TRUE <=> allocation & syntax OK, FALSE else.
+ *---------------------------------------------------------------------------*/
+
+extern bool_t parse_end_at_top_level(
+    VF_PARSER_T *p_parser,      /* The parser */
+    bool_t *p_top_level         /* Set TRUE iff slice ended between objects */
+    );
+
+/*---------------------------------------------------------------------------*
+ * NAME
+ *      vf_write_to_sink()
+ * 
+ * DESCRIPTION
+ *      Run a writer to completion, passing the text to a sink as it's
+ *      generated rather than saving it up for vf_write_to_buf().  The writer
+ *      must still be released with vf_write_end().
+ *
+ * RETURNS
+ *      TRUE <=> written OK, FALSE else.
+ *---------------------------------------------------------------------------*/
+
+extern bool_t vf_write_to_sink(
+    VF_WRITER_T *p_writer,      /* The writer */
+    vf_write_sink_t p_sink,     /* Where the text goes */
+    void *p_context             /* Context passed to p_sink */
+    );
+
+/*---------------------------------------------------------------------------*
+ * NAME
+ *      vf_write_measure()
+ * 
+ * DESCRIPTION
+ *      Run a writer to completion, just counting the text it would produce.
+ *      The writer must still be released with vf_write_end().
+ *
+ * RETURNS
+ *      TRUE <=> object could be written, FALSE else.
+ *---------------------------------------------------------------------------*/
+
+extern bool_t vf_write_measure(
+    VF_WRITER_T *p_writer,      /* The writer */
+    size_t *p_length            /* Where to return the length */
+    );
+
+/*---------------------------------------------------------------------------*
+ * NAME
+ *      vf_write_parallel()
+ * 
+ * DESCRIPTION
+ *      Write a list of top level objects to a sink using up to n_threads
+ *      threads.  The list is cut into runs of consecutive objects, the
+ *      calling thread writes the first straight to the sink while the rest
+ *      are written to buffers, which are passed on in order once each is
+ *      finished.  The text is the same as a single writer would produce.
+ *
+ * RETURNS
+ *      TRUE <=> written OK, FALSE else.
+ *---------------------------------------------------------------------------*/
+
+extern bool_t vf_write_parallel(
+    VF_OBJECT_T *p_object,      /* The first object to write */
+    vf_write_flags_t flags,     /* Flags controlling operation */
+    uint32_t n_threads,         /* Most threads to use, including the caller's */
+    vf_write_sink_t p_sink,     /* Where the text goes */
+    void *p_context             /* Context passed to p_sink */
+    );
+
 /*=============================================================================*
  End of file
  *============================================================================*/
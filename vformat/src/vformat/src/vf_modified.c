@@ -81,7 +81,10 @@ static const char vf_modified_c_vss_id[] = "$Header: /cvsroot/vformat/src/vforma
 /*============================================================================*
  Private Function Prototypes
  *============================================================================*/
-/* None */
+
+static void clear_object_modified(
+    VOBJECT_T *p_vobject        /* The object */
+    );
 
 /*============================================================================*
  Private Data
@@ -117,6 +120,31 @@ bool_t vf_is_modified(
     return ret;
 }
 
+/*---------------------------------------------------------------------------*
+ * NAME
+ *      vf_clear_modified()
+ * 
+ * DESCRIPTION
+ *      Clear the modified flags of the indicated object, and the rest of
+ *      the list if all is set.
+ *
+ * RETURNS
+ *      (none)
+ *---------------------------------------------------------------------------*/
+
+void vf_clear_modified(
+    VF_OBJECT_T *p_object,
+    bool_t all
+    )
+{
+    VOBJECT_T *p_vobject = (VOBJECT_T *)p_object;
+
+    for (;p_vobject;p_vobject = all ? p_vobject->p_next : NULL)
+    {
+        clear_object_modified(p_vobject);
+    }
+}
+
 /*---------------------------------------------------------------------------*
  * NAME
  *      mark_property_modified()
@@ -152,7 +180,37 @@ void mark_property_modified(
 /*============================================================================*
  Private Function Implementations
  *============================================================================*/
-/* None */
+
+/*---------------------------------------------------------------------------*
+ * NAME
+ *      clear_object_modified()
+ * 
+ * DESCRIPTION
+ *      Clear the modified flags of an object, its properties and the lists
+ *      of objects held in its properties.
+ *
+ * RETURNS
+ *      (none)
+ *---------------------------------------------------------------------------*/
+
+void clear_object_modified(
+    VOBJECT_T *p_vobject        /* The object */
+    )
+{
+    VPROP_T *p_prop;
+
+    p_vobject->modified = FALSE;
+
+    for (p_prop = p_vobject->p_props;p_prop;p_prop = p_prop->p_next)
+    {
+        p_prop->modified = FALSE;
+
+        if (VF_ENC_VOBJECT == p_prop->value.encoding)
+        {
+            vf_clear_modified((VF_OBJECT_T *)p_prop->value.v.o.p_object, TRUE);
+        }
+    }
+}
 
 /*============================================================================*
  End Of File
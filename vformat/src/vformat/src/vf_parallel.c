@@ -0,0 +1,871 @@
+/*******************************************************************************
+
+    (C) Nick Marley, 2001 -
+
+    This software is distributed under the GNU Lesser General Public Licence.
+    Please read and understand the comments at the top of vf_iface.h before use!
+
+FILE
+    $Workfile$
+    $Revision$
+    $Author$
+
+ORIGINAL AUTHOR
+    Nick Marley
+
+DESCRIPTION
+    Parsing a buffer holding many top level objects (a phonebook, say) on
+    several threads.
+
+    The buffer is cut into slices at lines which look like the BEGIN of a
+    top level object, each slice is parsed into an arena of its own and the
+    lists of objects are joined up in order.  A guess at a cut can be wrong
+    (a nested object, a QUOTED-PRINTABLE value containing "BEGIN:") so each
+    slice's parser reports whether it ended between objects.  If not, that
+    slice and everything after it is parsed again in a single pass, which
+    is exactly what the serial parser would have done.
+
+    Writing such a list on several threads is simpler.  The list is cut
+    into shards of consecutive objects, each object being written by a
+    writer of its own with VFWF_ONEOBJECT set.  The calling thread writes
+    the first shard straight to the sink and the others are written to
+    buffers, passed on in order as they're finished.
+
+REFERENCES
+    (none)
+
+MODIFICATION HISTORY
+ *  $Log$
+ *
+ *******************************************************************************/
+
+#ifndef NORCSID
+static const char vf_parallel_c_vss_id[] = "$Header$";
+#endif
+
+/*=============================================================================*
+ ANSI C & System-wide Header Files
+ *=============================================================================*/
+
+#include <common/types.h>
+
+/* vf_config.h says which of the optional headers below are available */
+#include "vf_config.h"
+
+#if defined(HAS_PTHREAD_H)
+#include <pthread.h>
+#endif
+
+/*============================================================================*
+ Interface Header Files
+ *============================================================================*/
+
+#include "vformat/vf_iface.h"
+
+/*============================================================================*
+ Local Header File
+ *============================================================================*/
+
+#include "vf_malloc.h"
+#include "vf_internals.h"
+#include "vf_strings.h"
+#include "vf_string_arrays.h"
+
+/*============================================================================*
+ Public Data
+ *============================================================================*/
+/* None */
+
+/*============================================================================*
+ Private Defines
+ *============================================================================*/
+
+/*
+ * Buffers are cut into at most this many slices, none smaller than
+ * PARALLEL_MINSLICE characters - below that a thread costs more than it
+ * saves.
+ */
+#if !defined(PARALLEL_MAXSLICES)
+#define PARALLEL_MAXSLICES          (64)
+#endif
+
+#if !defined(PARALLEL_MINSLICE)
+#define PARALLEL_MINSLICE           (64 * 1024)
+#endif
+
+/*
+ * Lists are written in at most PARALLEL_MAXSLICES shards, none with fewer
+ * than PARALLEL_MINSHARD objects.
+ */
+#if !defined(PARALLEL_MINSHARD)
+#define PARALLEL_MINSHARD           (32)
+#endif
+
+#define CRETURN                     '\r'
+#define LINEFEED                    '\n'
+#define EQUALS                      '='
+
+#define ISCRORNL(c)                 ((CRETURN == (c)) || (LINEFEED == (c)))
+#define TOUPPER(c)                  ((('a' <= (c)) && ((c) <= 'z')) ? ((c) - 'a' + 'A') : (c))
+
+/*============================================================================*
+ Private Data Types
+ *============================================================================*/
+
+/*----------------------------------------------------------------------------*
+ * PURPOSE
+ *      A slice of the buffer and the objects parsed from it.
+ *----------------------------------------------------------------------------*/
+
+typedef struct
+{
+    const char      *p_chars;           /* Start of the slice */
+    uint32_t        numchars;           /* Length of the slice */
+    bool_t          last;               /* Runs to the end of the buffer? */
+
+    VOBJECT_T       *p_objects;         /* Top level objects parsed */
+    VOBJECT_T       *p_last;            /* Last of them */
+    bool_t          ok;                 /* Allocation & syntax OK */
+    bool_t          top_level;          /* Slice ended between objects */
+
+#if defined(HAS_PTHREAD_H)
+    pthread_t       thread;             /* Thread parsing the slice */
+    bool_t          threaded;           /* Was one started? */
+#endif
+}
+VSLICE_T;
+
+/*----------------------------------------------------------------------------*
+ * PURPOSE
+ *      A run of consecutive top level objects being written, and where the
+ *      text is going.
+ *----------------------------------------------------------------------------*/
+
+typedef struct
+{
+    VOBJECT_T       *p_first;           /* First object in the shard */
+    uint32_t        n_objects;          /* Number of objects in the shard */
+    vf_write_flags_t flags;             /* Caller's flags */
+
+    vf_write_sink_t p_sink;             /* Where the text goes */
+    void            *p_context;         /* Context passed to p_sink */
+
+    char            *p_text;            /* Text buffered, if not going straight to the caller */
+    uint32_t        length;             /* Characters in p_text */
+    uint32_t        alloc;              /* Bytes allocated for p_text */
+    bool_t          ok;                 /* Written OK */
+
+#if defined(HAS_PTHREAD_H)
+    pthread_t       thread;             /* Thread writing the shard */
+    bool_t          threaded;           /* Was one started? */
+#endif
+}
+VSHARD_T;
+
+/*============================================================================*
+ Private Function Prototypes
+ *============================================================================*/
+
+static uint32_t find_slice_start(
+    const char *p_buffer,
+    uint32_t length,
+    uint32_t from
+    );
+
+static bool_t line_starts_with(
+    const char *p_line,
+    uint32_t numchars,
+    const char *p_tag
+    );
+
+static void parse_slice(
+    VSLICE_T *p_slice
+    );
+
+static bool_t decode_for_write(
+    VOBJECT_T *p_object
+    );
+
+static void write_shard(
+    VSHARD_T *p_shard
+    );
+
+static bool_t append_to_shard(
+    void *p_context,
+    const char *p_chars,
+    uint32_t numchars,
+    bool_t stable
+    );
+
+#if defined(HAS_PTHREAD_H)
+static void *slice_thread(
+    void *p_arg
+    );
+
+static void *shard_thread(
+    void *p_arg
+    );
+#endif
+
+/*============================================================================*
+ Private Data
+ *============================================================================*/
+/* None */
+
+/*============================================================================*
+ Public Function Implementations
+ *============================================================================*/
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      vf_parse_buffer_parallel()
+ *
+ * DESCRIPTION
+ *      Parse a complete buffer holding a list of top level objects, using
+ *      up to n_threads threads.
+ *
+ * RETURNS
+ *      TRUE <=> allocation & syntax OK, FALSE else.
+ *---------------------------------------------------------------------------*/
+
+bool_t vf_parse_buffer_parallel(
+    VF_OBJECT_T **pp_object,    /* The object we're parsing into */
+    const char *p_buffer,       /* Caller's buffer, not modified */
+    uint32_t length,            /* Number of characters in the buffer */
+    uint32_t n_threads          /* Most threads to use, including the caller's */
+    )
+{
+    bool_t ret = TRUE;
+    VSLICE_T *p_slices;
+    VOBJECT_T *p_last = NULL;
+    uint32_t n_slices;
+    uint32_t step;
+    uint32_t k;
+
+    if (!pp_object || !p_buffer)
+    {
+        return FALSE;
+    }
+
+    *pp_object = NULL;
+
+    n_slices = length / PARALLEL_MINSLICE;
+
+    if (n_slices > n_threads)
+    {
+        n_slices = n_threads;
+    }
+
+    if (n_slices > PARALLEL_MAXSLICES)
+    {
+        n_slices = PARALLEL_MAXSLICES;
+    }
+
+    if (!n_slices)
+    {
+        n_slices = 1;
+    }
+
+    p_slices = (VSLICE_T *)vf_malloc(n_slices * sizeof(VSLICE_T));
+
+    if (!p_slices)
+    {
+        return FALSE;
+    }
+
+    p_memset(p_slices, '\0', n_slices * sizeof(VSLICE_T));
+
+    /*
+     * Cut the buffer at the first likely looking BEGIN after each multiple
+     * of step.  We may run out of them, leaving fewer slices.
+     */
+    step = length / n_slices;
+
+    p_slices[0].p_chars = p_buffer;
+
+    for (k = 1;k < n_slices;k++)
+    {
+        uint32_t from = k * step;
+        uint32_t start;
+
+        if (from < (uint32_t)(p_slices[k - 1].p_chars - p_buffer))
+        {
+            from = (uint32_t)(p_slices[k - 1].p_chars - p_buffer);
+        }
+
+        start = find_slice_start(p_buffer, length, from);
+
+        if (start >= length)
+        {
+            break;
+        }
+
+        p_slices[k].p_chars = p_buffer + start;
+        p_slices[k - 1].numchars = (uint32_t)(p_slices[k].p_chars - p_slices[k - 1].p_chars);
+    }
+
+    n_slices = k;
+
+    p_slices[n_slices - 1].numchars = length - (uint32_t)(p_slices[n_slices - 1].p_chars - p_buffer);
+    p_slices[n_slices - 1].last = TRUE;
+
+    /*
+     * Parse the slices, the calling thread taking the first.
+     */
+    for (k = 1;k < n_slices;k++)
+    {
+#if defined(HAS_PTHREAD_H)
+        p_slices[k].threaded = (bool_t)(0 == pthread_create(&p_slices[k].thread, NULL, slice_thread, &p_slices[k]));
+
+        if (p_slices[k].threaded)
+        {
+            continue;
+        }
+#endif
+        parse_slice(&p_slices[k]);
+    }
+
+    parse_slice(&p_slices[0]);
+
+#if defined(HAS_PTHREAD_H)
+    for (k = 1;k < n_slices;k++)
+    {
+        if (p_slices[k].threaded)
+        {
+            pthread_join(p_slices[k].thread, NULL);
+        }
+    }
+#endif
+
+    /*
+     * Join the lists up.  A slice which didn't end between objects means
+     * the cut after it was wrong, so everything from there on is parsed
+     * again in one go.
+     */
+    for (k = 0;ret && (k < n_slices);k++)
+    {
+        VSLICE_T *p_slice = &p_slices[k];
+
+        if (p_slice->ok && !p_slice->top_level && !p_slice->last)
+        {
+            uint32_t j;
+
+            for (j = k;j < n_slices;j++)
+            {
+                vf_delete_object((VF_OBJECT_T *)p_slices[j].p_objects, TRUE);
+                p_slices[j].p_objects = NULL;
+            }
+
+            p_slice->numchars = length - (uint32_t)(p_slice->p_chars - p_buffer);
+            p_slice->last = TRUE;
+
+            parse_slice(p_slice);
+
+            n_slices = k + 1;
+        }
+
+        if (!p_slice->ok)
+        {
+            /* The serial parser fails here too */
+
+            ret = FALSE;
+        }
+        else
+        if (p_slice->p_objects)
+        {
+            if (p_last)
+            {
+                p_last->p_next = p_slice->p_objects;
+            }
+            else
+            {
+                *pp_object = (VF_OBJECT_T *)p_slice->p_objects;
+            }
+
+            p_last = p_slice->p_last;
+            p_slice->p_objects = NULL;
+        }
+    }
+
+    if (!ret)
+    {
+        for (k = 0;k < n_slices;k++)
+        {
+            vf_delete_object((VF_OBJECT_T *)p_slices[k].p_objects, TRUE);
+        }
+
+        vf_delete_object(*pp_object, TRUE);
+        *pp_object = NULL;
+    }
+
+    vf_free(p_slices);
+
+    return ret;
+}
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      vf_write_parallel()
+ *
+ * DESCRIPTION
+ *      Write a list of top level objects to a sink using up to n_threads
+ *      threads.  Short lists, or a single thread, just get a single writer.
+ *
+ * RETURNS
+ *      TRUE <=> written OK, FALSE else.
+ *---------------------------------------------------------------------------*/
+
+bool_t vf_write_parallel(
+    VF_OBJECT_T *p_object,      /* The first object to write */
+    vf_write_flags_t flags,     /* Flags controlling operation */
+    uint32_t n_threads,         /* Most threads to use, including the caller's */
+    vf_write_sink_t p_sink,     /* Where the text goes */
+    void *p_context             /* Context passed to p_sink */
+    )
+{
+    bool_t ret = TRUE;
+    VSHARD_T *p_shards = NULL;
+    VOBJECT_T *p_vobject;
+    uint32_t n_objects = 0;
+    uint32_t n_shards = 1;
+    uint32_t k;
+
+    if (!p_object || !p_sink)
+    {
+        return FALSE;
+    }
+
+    /* Buffering shards only pays if they're written at the same time */
+
+#if defined(HAS_PTHREAD_H)
+    if (1 < n_threads)
+    {
+        for (p_vobject = (VOBJECT_T *)p_object;p_vobject;p_vobject = p_vobject->p_next)
+        {
+            n_objects++;
+        }
+
+        n_shards = n_objects / PARALLEL_MINSHARD;
+
+        if (n_shards > n_threads)
+        {
+            n_shards = n_threads;
+        }
+
+        if (n_shards > PARALLEL_MAXSLICES)
+        {
+            n_shards = PARALLEL_MAXSLICES;
+        }
+    }
+
+    if (1 < n_shards)
+    {
+        p_shards = (VSHARD_T *)vf_malloc(n_shards * sizeof(VSHARD_T));
+    }
+#else
+    (void)n_threads;
+#endif
+
+    if (!p_shards)
+    {
+        VF_WRITER_T *p_writer;
+
+        ret = vf_write_init(&p_writer, p_object, flags);
+
+        if (ret)
+        {
+            ret = vf_write_to_sink(p_writer, p_sink, p_context);
+
+            vf_write_end(p_writer);
+        }
+
+        return ret;
+    }
+
+    p_memset(p_shards, '\0', n_shards * sizeof(VSHARD_T));
+
+    /*
+     * Values left encoded in an arena tree are decoded into the arena,
+     * which mustn't happen on several threads at once.
+     */
+    ret = decode_for_write((VOBJECT_T *)p_object);
+
+    /*
+     * Cut the list into shards of as near the same number of objects as
+     * possible.
+     */
+    p_vobject = (VOBJECT_T *)p_object;
+
+    for (k = 0;ret && (k < n_shards);k++)
+    {
+        uint32_t j;
+
+        p_shards[k].p_first = p_vobject;
+        p_shards[k].n_objects = (n_objects / n_shards) + ((k < (n_objects % n_shards)) ? 1 : 0);
+        p_shards[k].flags = flags;
+        p_shards[k].p_sink = append_to_shard;
+        p_shards[k].p_context = &p_shards[k];
+
+        for (j = 0;j < p_shards[k].n_objects;j++)
+        {
+            p_vobject = p_vobject->p_next;
+        }
+    }
+
+    if (ret)
+    {
+        /*
+         * Write the shards, the calling thread taking the first and passing
+         * its text straight on.
+         */
+        p_shards[0].p_sink = p_sink;
+        p_shards[0].p_context = p_context;
+
+        for (k = 1;k < n_shards;k++)
+        {
+#if defined(HAS_PTHREAD_H)
+            p_shards[k].threaded = (bool_t)(0 == pthread_create(&p_shards[k].thread, NULL, shard_thread, &p_shards[k]));
+
+            if (p_shards[k].threaded)
+            {
+                continue;
+            }
+#endif
+            write_shard(&p_shards[k]);
+        }
+
+        write_shard(&p_shards[0]);
+
+        ret = p_shards[0].ok;
+
+        /*
+         * Pass the rest on in order.  The buffers are freed before the sink
+         * is done with the text, so it isn't stable.
+         */
+        for (k = 1;k < n_shards;k++)
+        {
+#if defined(HAS_PTHREAD_H)
+            if (p_shards[k].threaded)
+            {
+                pthread_join(p_shards[k].thread, NULL);
+            }
+#endif
+
+            if (ret)
+            {
+                ret = p_shards[k].ok;
+            }
+
+            if (ret && p_shards[k].length)
+            {
+                ret = p_sink(p_context, p_shards[k].p_text, p_shards[k].length, FALSE);
+            }
+        }
+    }
+
+    for (k = 1;k < n_shards;k++)
+    {
+        if (p_shards[k].p_text)
+        {
+            vf_free(p_shards[k].p_text);
+        }
+    }
+
+    vf_free(p_shards);
+
+    return ret;
+}
+
+/*============================================================================*
+ Private Function Implementations
+ *============================================================================*/
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      find_slice_start()
+ *
+ * DESCRIPTION
+ *      Look for a line after the one containing position from which starts
+ *      "BEGIN:", where the last non blank line before it starts "END:" and
+ *      isn't a QUOTED-PRINTABLE soft line break.  This is almost certainly
+ *      the start of a top level object, parse_end_at_top_level() will tell
+ *      us if not.
+ *
+ * RETURNS
+ *      Offset of the line, length if there's no such line.
+ *---------------------------------------------------------------------------*/
+
+uint32_t find_slice_start(
+    const char *p_buffer,       /* The buffer */
+    uint32_t length,            /* Number of characters in the buffer */
+    uint32_t from               /* Where to start looking */
+    )
+{
+    uint32_t i = from;
+    uint32_t prev_start = length;
+    uint32_t prev_end = length;
+
+    while ((i < length) && !ISCRORNL(p_buffer[i]))
+    {
+        i++;
+    }
+
+    while (i < length)
+    {
+        uint32_t start;
+
+        while ((i < length) && ISCRORNL(p_buffer[i]))
+        {
+            i++;
+        }
+
+        start = i;
+
+        while ((i < length) && !ISCRORNL(p_buffer[i]))
+        {
+            i++;
+        }
+
+        if (start == i)
+        {
+            /* End of buffer */
+        }
+        else
+        if ((prev_start < length) &&
+            line_starts_with(p_buffer + start, i - start, VFP_BEGIN ":") &&
+            line_starts_with(p_buffer + prev_start, prev_end - prev_start, VFP_END ":") &&
+            (EQUALS != p_buffer[prev_end - 1]))
+        {
+            return start;
+        }
+        else
+        {
+            prev_start = start;
+            prev_end = i;
+        }
+    }
+
+    return length;
+}
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      line_starts_with()
+ *
+ * DESCRIPTION
+ *      Case insensitive check of the start of a line against a tag.
+ *
+ * RETURNS
+ *      TRUE <=> the line starts with the tag, FALSE else.
+ *---------------------------------------------------------------------------*/
+
+bool_t line_starts_with(
+    const char *p_line,         /* The line, not terminated */
+    uint32_t numchars,          /* Length of the line */
+    const char *p_tag           /* Upper case tag */
+    )
+{
+    uint32_t i;
+
+    for (i = 0;p_tag[i];i++)
+    {
+        if ((i >= numchars) || (TOUPPER(p_line[i]) != p_tag[i]))
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      parse_slice()
+ *
+ * DESCRIPTION
+ *      Parse a slice of the buffer into an arena sized for it.  The last
+ *      slice is finished off just as vf_parse_buffer() would.  The parser
+ *      only writes to the text it's given when set up by vf_parse_buffer(),
+ *      so casting away the const is safe.
+ *
+ * RETURNS
+ *      (none)
+ *---------------------------------------------------------------------------*/
+
+void parse_slice(
+    VSLICE_T *p_slice           /* The slice */
+    )
+{
+    VF_PARSER_T *p_parser;
+
+    p_slice->ok = FALSE;
+    p_slice->top_level = FALSE;
+    p_slice->p_objects = NULL;
+    p_slice->p_last = NULL;
+
+    if (vf_parse_init_arena(&p_parser, (VF_OBJECT_T **)&p_slice->p_objects, p_slice->numchars))
+    {
+        p_slice->ok = vf_parse_text(p_parser, (char *)p_slice->p_chars, p_slice->numchars);
+
+        if (p_slice->last ? !vf_parse_end(p_parser) : !parse_end_at_top_level(p_parser, &p_slice->top_level))
+        {
+            p_slice->ok = FALSE;
+        }
+    }
+
+    for (p_slice->p_last = p_slice->p_objects;p_slice->p_last && p_slice->p_last->p_next;)
+    {
+        p_slice->p_last = p_slice->p_last->p_next;
+    }
+}
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      decode_for_write()
+ *
+ * DESCRIPTION
+ *      Decode the values in a list of objects, and the objects within them,
+ *      that the writer would decode and that would be decoded into an
+ *      arena.  Values it can write as they are, or which are decoded onto
+ *      the heap, are left to the writer.
+ *
+ * RETURNS
+ *      TRUE <=> allocation & syntax OK, FALSE else.
+ *---------------------------------------------------------------------------*/
+
+bool_t decode_for_write(
+    VOBJECT_T *p_object         /* First object in the list */
+    )
+{
+    bool_t ret = TRUE;
+
+    for (;ret && p_object;p_object = p_object->p_next)
+    {
+        VPROP_T *p_prop;
+
+        for (p_prop = p_object->p_props;ret && p_prop;p_prop = p_prop->p_next)
+        {
+            if (VF_ENC_VOBJECT == p_prop->value.encoding)
+            {
+                ret = decode_for_write(p_prop->value.v.o.p_object);
+            }
+            else
+            if (p_prop->value.lazy && p_object->p_arena && !lazy_value_verbatim(p_prop))
+            {
+                ret = decode_lazy_value(p_prop);
+            }
+        }
+    }
+
+    return ret;
+}
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      write_shard()
+ *
+ * DESCRIPTION
+ *      Write the objects in a shard one at a time to the shard's sink.
+ *
+ * RETURNS
+ *      (none)
+ *---------------------------------------------------------------------------*/
+
+void write_shard(
+    VSHARD_T *p_shard           /* The shard */
+    )
+{
+    VOBJECT_T *p_object = p_shard->p_first;
+    uint32_t k;
+
+    p_shard->ok = TRUE;
+
+    for (k = 0;p_shard->ok && (k < p_shard->n_objects);k++)
+    {
+        VF_WRITER_T *p_writer;
+
+        p_shard->ok = vf_write_init(&p_writer, (VF_OBJECT_T *)p_object, (vf_write_flags_t)(p_shard->flags | VFWF_ONEOBJECT));
+
+        if (p_shard->ok)
+        {
+            p_shard->ok = vf_write_to_sink(p_writer, p_shard->p_sink, p_shard->p_context);
+
+            vf_write_end(p_writer);
+        }
+
+        p_object = p_object->p_next;
+    }
+}
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      append_to_shard()
+ *
+ * DESCRIPTION
+ *      Writer sink.  Copy the text to the end of the shard's buffer.
+ *
+ * RETURNS
+ *      TRUE <=> allocation OK, FALSE else.
+ *---------------------------------------------------------------------------*/
+
+bool_t append_to_shard(
+    void *p_context,            /* The VSHARD_T */
+    const char *p_chars,        /* The text */
+    uint32_t numchars,          /* Number of characters */
+    bool_t stable               /* Text stays put till the write's done? */
+    )
+{
+    VSHARD_T *p_shard = (VSHARD_T *)p_context;
+
+    (void)stable;
+
+    return append_to_buffer(&p_shard->p_text, &p_shard->length, &p_shard->alloc, p_chars, numchars, FALSE);
+}
+
+#if defined(HAS_PTHREAD_H)
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      slice_thread()
+ *
+ * DESCRIPTION
+ *      Thread entry point for parse_slice().
+ *
+ * RETURNS
+ *      NULL.
+ *---------------------------------------------------------------------------*/
+
+void *slice_thread(
+    void *p_arg                 /* The slice */
+    )
+{
+    parse_slice((VSLICE_T *)p_arg);
+
+    return NULL;
+}
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      shard_thread()
+ *
+ * DESCRIPTION
+ *      Thread entry point for write_shard().
+ *
+ * RETURNS
+ *      NULL.
+ *---------------------------------------------------------------------------*/
+
+void *shard_thread(
+    void *p_arg                 /* The shard */
+    )
+{
+    write_shard((VSHARD_T *)p_arg);
+
+    return NULL;
+}
+
+#endif
+
+/*============================================================================*
+ End Of File
+ *============================================================================*/
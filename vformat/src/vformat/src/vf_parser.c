@@ -123,6 +123,8 @@ static const char vf_parser_c_vss_id[] = "$Header: /cvsroot/vformat/src/vformat/
 #include "vf_internals.h"
 #include "vf_strings.h"
 #include "vf_string_arrays.h"
+#include "vf_arena.h"
+#include "vf_atoms.h"
 
 /*============================================================================*
  Public Data
@@ -167,9 +169,88 @@ static const char vf_parser_c_vss_id[] = "$Header: /cvsroot/vformat/src/vformat/
 #define _VF_STATE_QPEQUALSC1        (7)     /* After = in QP */
 #define _VF_STATE_QPEQUALSC2        (8)     /* After =X in QP */
 #define _VF_STATE_BASE64            (9)     /* Reading BASE64 */
+#define _VF_STATE_RESYNC            (10)    /* Skipping to line end after an error */
+#define _VF_STATE_RESYNCNL          (11)    /* At line end after an error */
+#define _VF_STATE_COUNT             (12)
 
 #define ISCRORNL(c)                 ((CRETURN == (c)) || (LINEFEED == (c)))
 
+/*
+ * Most QUOTED-PRINTABLE text decoded into the workspace before it's added to
+ * the value, so the workspace doesn't grow with the size of the input chunk.
+ */
+#define QPDECODEBLOCK               (4096)
+
+/*
+ * Character classes used to find the next significant character.  Any run of
+ * characters not in the "delimiter" set for the current state can be appended
+ * in one go rather than being pushed through the state machine one at a time.
+ */
+#define _VF_CC_CRLF                 (0x01)
+#define _VF_CC_SEMICOLON            (0x02)
+#define _VF_CC_COLON                (0x04)
+#define _VF_CC_PERIOD               (0x08)
+#define _VF_CC_BACKSLASH            (0x10)
+#define _VF_CC_EQUALS               (0x20)
+
+#define _VF_CC_NAMEDELIMS           (_VF_CC_CRLF | _VF_CC_SEMICOLON | _VF_CC_COLON | _VF_CC_PERIOD | _VF_CC_BACKSLASH)
+#define _VF_CC_VALUEDELIMS          (_VF_CC_CRLF | _VF_CC_SEMICOLON)
+#define _VF_CC_QPDELIMS             (_VF_CC_CRLF | _VF_CC_SEMICOLON | _VF_CC_EQUALS)
+#define _VF_CC_BASE64DELIMS         (_VF_CC_CRLF | _VF_CC_SEMICOLON | _VF_CC_COLON)
+
+/*
+ * The state machine is driven by lex_action[], which gives the action to take
+ * on each class of character (lex_class[]) in each state.  Most actions take
+ * a run of characters in one go, see span_length().
+ */
+#define _VF_LC_OTHER                (0)
+#define _VF_LC_CRLF                 (1)
+#define _VF_LC_SEMICOLON            (2)
+#define _VF_LC_COLON                (3)
+#define _VF_LC_PERIOD               (4)
+#define _VF_LC_BACKSLASH            (5)
+#define _VF_LC_EQUALS               (6)
+#define _VF_LC_BLANK                (7)     /* Space or tab */
+#define _VF_LC_COUNT                (8)
+
+#define _VF_ACT_IGNORE              (0)     /* Drop the character */
+#define _VF_ACT_NAMERUN             (1)     /* Run of name characters */
+#define _VF_ACT_NAMEFIELD           (2)     /* ';' starts the next name field */
+#define _VF_ACT_NAMEGROUP           (3)     /* '.' ends a group name */
+#define _VF_ACT_NAMEEND             (4)     /* ':' switches to the value's encoding */
+#define _VF_ACT_NAMEESCAPE          (5)     /* '\' in a name */
+#define _VF_ACT_NAMEEOL             (6)     /* Line end in a name, drop it */
+#define _VF_ACT_ESCAPED             (7)     /* Escaped ';' */
+#define _VF_ACT_NAMEERROR           (8)     /* Anything else escaped */
+#define _VF_ACT_VALUERUN            (9)     /* Run of plain value characters */
+#define _VF_ACT_VALUEFIELD          (10)    /* ';' starts the next value field */
+#define _VF_ACT_VALUEEOL            (11)    /* Line end, the value may be folded */
+#define _VF_ACT_UNFOLD              (12)    /* White space after a line end */
+#define _VF_ACT_VALUEEND            (13)    /* Value complete, start of the next name */
+#define _VF_ACT_QPRUN               (14)    /* QUOTED-PRINTABLE text */
+#define _VF_ACT_QPFIELD             (15)    /* ';' in QUOTED-PRINTABLE */
+#define _VF_ACT_QPEOL               (16)    /* Hard line end, value complete */
+#define _VF_ACT_QPRESUME            (17)    /* Text after a soft line break */
+#define _VF_ACT_QPESCAPE1           (18)    /* Character after '=' */
+#define _VF_ACT_QPESCAPE2           (19)    /* Character after "=X" */
+#define _VF_ACT_B64RUN              (20)    /* BASE64 text */
+#define _VF_ACT_B64EOL              (21)    /* End of a BASE64 line */
+#define _VF_ACT_B64REPLAY           (22)    /* Line was a name after all */
+#define _VF_ACT_RESYNCRUN           (23)    /* Text of a line in error */
+#define _VF_ACT_RESYNCEOL           (24)    /* End of a line in error */
+#define _VF_ACT_RESYNCFOLD          (25)    /* Folded line in error */
+#define _VF_ACT_RESYNCEND           (26)    /* Start of the next name */
+
+/*
+ * Flags the BASE64 padding character in base64_value[].
+ */
+#define _VF_B64_PAD                 (0x80)
+
+/*
+ * Marks characters that aren't hex digits in hex_value[].
+ */
+#define _VF_HEX_BAD                 (0xFF)
+
 /*============================================================================*
  Private Data Types
  *===========================================================================*/
@@ -183,10 +264,59 @@ typedef struct
 {
     int             state;              /* Main state variable */
     char            qpchar;             /* Workspace for QuotedPrintable decoder */
-    char            *p_b64buf;          /* Workspace for BASE64 decoder */
+    char            *p_line;            /* BASE64 line split across calls, QP output */
+    uint32_t        n_line;             /* Length of the buffered line */
+    uint32_t        n_linealloc;        /* Bytes allocated in p_line */
     VOBJECT_T       **pp_root_object;   /* Pointer to the root */
+    VOBJECT_T       *p_last_root;       /* Last object in the top level list */
     VOBJECT_T       *p_object;          /* Current position in tree */
     VPROP_T         prop;               /* Current property, copied into tree on completion */
+
+    /*
+     * Caller's buffer when parsing with vf_parse_buffer(), fields are left
+     * as views onto this rather than copied.  The view being built up is
+     * terminated once the character after it has been read.
+     */
+    char            *p_view_start;
+    char            *p_view_end;
+    char            *p_view_seal;       /* Where to write the terminator */
+    VSTRARRAY_T     *p_view_strarray;   /* Array holding the view */
+
+    /*
+     * Arena the tree is built in, if any.  prop is then a scratch area whose
+     * contents are moved into the arena as each property completes.
+     */
+    VARENA_T        *p_arena;
+
+    /*
+     * Set by vf_parse_init_callback(), each top level object is passed to
+     * p_callback when complete rather than kept in a list.  pp_root_object
+     * then points at p_cbroot, which holds the object being built.
+     */
+    vf_parse_callback_t p_callback;
+    uint32_t        n_cbcontext;
+    void            *p_cbcontext;
+    VOBJECT_T       *p_cbroot;
+
+    vf_parse_flags_t flags;             /* VFPF_xxx */
+
+    /*
+     * Property names set by vf_parse_set_filter(), each an atom or an
+     * allocated copy.  skip is set once a name is read if the value is to
+     * be dropped rather than added to the tree.
+     */
+    const char      **pp_filter;
+    uint32_t        n_filter;
+    bool_t          filter_allow;
+    bool_t          skip;
+
+    /*
+     * Syntax errors.  p_error is set to the offending character when one
+     * is found, so it can be told apart from running out of memory.
+     */
+    const char      *p_error;
+    uint32_t        n_offset;           /* Characters parsed before this call */
+    VF_PARSE_DIAG_T *p_diag;            /* Set by vf_parse_set_diagnostics() */
 }
 VPARSE_T;
 
@@ -199,29 +329,72 @@ static bool_t append_value_to_object(
     VPARSE_T *p_parse           /* The property we're naming */
     );
 
+static bool_t handle_name_chars(
+    VPARSE_T *p_parse,          /* Current parse state info */
+    char c,                     /* Next character */
+    char *p_chars,              /* Characters to parse, starting with c */
+    uint32_t numchars,          /* Number of characters available */
+    uint32_t *p_used            /* Number of characters used */
+    );
+
 static bool_t handle_base64_chars(
     VPARSE_T *p_parse,          /* The property value we're adding to */
     const char *p_chars,        /* Pointer to characters to add */
-    int numchars                /* Number of characters */
+    uint32_t numchars           /* Number of characters */
+    );
+
+static uint32_t decode_base64_quads(
+    const uint8_t *p_quad,      /* Groups of 4 characters */
+    uint32_t num,               /* Number of groups */
+    uint8_t *p_out              /* Room for 3 * num bytes */
+    );
+
+static bool_t replay_base64_line(
+    VPARSE_T *p_parse           /* Current parse state info */
+    );
+
+static bool_t handle_qp_chars(
+    VPARSE_T *p_parse,          /* Current parse state info */
+    char *p_chars,              /* Characters to parse */
+    uint32_t numchars,          /* Number of characters available */
+    uint32_t *p_used            /* Number of characters used */
+    );
+
+static bool_t capture_qp_chars(
+    VPARSE_T *p_parse,          /* Current parse state info */
+    const char *p_chars,        /* Characters to parse */
+    uint32_t numchars,          /* Number of characters available */
+    uint32_t *p_used            /* Number of characters used */
     );
 
-static vf_encoding_t deduce_encoding(
-    VSTRARRAY_T *p_propname     /* Property name */
+static bool_t skip_property(
+    VPARSE_T *p_parse           /* Current parse state info */
     );
 
-static uint8_t base64_to_char(
-    char c                      /* Character to convert */
+static void free_filter(
+    VPARSE_T *p_parse           /* Current parse state info */
     );
 
-static bool_t is_hex_digit(
-    uint8_t *p_nibble,          /* Output nibble value */
-    char c                      /* Character read from file */
+static uint32_t resync_after_error(
+    VPARSE_T *p_parse,          /* Current parse state info */
+    char c,                     /* Character being parsed */
+    const char *p_chars,        /* Characters being parsed */
+    uint32_t numchars,          /* Number of characters */
+    uint32_t i                  /* Index of c */
     );
 
 static bool_t handle_value_complete(
     VPARSE_T *p_parse           /* Current parse state info */
     );
 
+static bool_t start_value_string(
+    VPARSE_T *p_parse           /* Current parse state info */
+    );
+
+static void deliver_object(
+    VPARSE_T *p_parse           /* Current parse state info */
+    );
+
 static bool_t alloc_next_object(
     VPARSE_T *p_parse,          /* Current parse state info */
     char *p_type                /* Type of object */
@@ -243,10 +416,149 @@ static bool_t append_group_name(
     VPROP_T *p_prop            /* Property we're updating */
     );
 
+static bool_t append_chars(
+    VPARSE_T *p_parse,          /* Current parse state info */
+    VSTRARRAY_T *p_strarray,    /* Array we're appending to */
+    char *p_chars,              /* Characters to append */
+    uint32_t numchars           /* Number of characters */
+    );
+
+static uint32_t span_length(
+    const char *p_chars,        /* Characters to scan */
+    uint32_t numchars,          /* Number of characters available */
+    uint8_t delims              /* Character classes ending the span */
+    );
+
 /*============================================================================*
  Private Data
  *===========================================================================*/
-/* None */
+
+/*
+ * Character class of each octet, see _VF_CC_xxx.
+ */
+static const uint8_t char_class[256] =
+{
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x01, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x02, 0x00, 0x20, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+};
+
+/*
+ * Class of each octet for lex_action[], see _VF_LC_xxx.
+ */
+static const uint8_t lex_class[256] =
+{
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 7, 1, 0, 0, 1, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    7, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 3, 2, 0, 6, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 5, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+
+/*
+ * Action for each class of character in each state.  Columns are in
+ * _VF_LC_xxx order:
+ *
+ *      other, cr/lf, ';', ':', '.', '\\', '=', space/tab
+ */
+static const uint8_t lex_action[_VF_STATE_COUNT][_VF_LC_COUNT] =
+{
+    /* (none) */
+    { _VF_ACT_IGNORE,     _VF_ACT_IGNORE,     _VF_ACT_IGNORE,     _VF_ACT_IGNORE,     _VF_ACT_IGNORE,     _VF_ACT_IGNORE,     _VF_ACT_IGNORE,     _VF_ACT_IGNORE     },
+    /* _VF_STATE_PROPNAME */
+    { _VF_ACT_NAMERUN,    _VF_ACT_NAMEEOL,    _VF_ACT_NAMEFIELD,  _VF_ACT_NAMEEND,    _VF_ACT_NAMEGROUP,  _VF_ACT_NAMEESCAPE, _VF_ACT_NAMERUN,    _VF_ACT_NAMERUN    },
+    /* _VF_STATE_PROPNAMEESCAPE */
+    { _VF_ACT_NAMEERROR,  _VF_ACT_NAMEERROR,  _VF_ACT_ESCAPED,    _VF_ACT_NAMEERROR,  _VF_ACT_NAMEERROR,  _VF_ACT_NAMEERROR,  _VF_ACT_NAMEERROR,  _VF_ACT_NAMEERROR  },
+    /* _VF_STATE_RFC822VALUE */
+    { _VF_ACT_VALUERUN,   _VF_ACT_VALUEEOL,   _VF_ACT_VALUEFIELD, _VF_ACT_VALUERUN,   _VF_ACT_VALUERUN,   _VF_ACT_VALUERUN,   _VF_ACT_VALUERUN,   _VF_ACT_VALUERUN   },
+    /* _VF_STATE_RFC822VALUEFOLD */
+    { _VF_ACT_VALUEEND,   _VF_ACT_IGNORE,     _VF_ACT_VALUEEND,   _VF_ACT_VALUEEND,   _VF_ACT_VALUEEND,   _VF_ACT_VALUEEND,   _VF_ACT_VALUEEND,   _VF_ACT_UNFOLD     },
+    /* _VF_STATE_QPIDLE */
+    { _VF_ACT_QPRUN,      _VF_ACT_QPEOL,      _VF_ACT_QPFIELD,    _VF_ACT_QPRUN,      _VF_ACT_QPRUN,      _VF_ACT_QPRUN,      _VF_ACT_QPRUN,      _VF_ACT_QPRUN      },
+    /* _VF_STATE_QPIDLENL */
+    { _VF_ACT_QPRESUME,   _VF_ACT_IGNORE,     _VF_ACT_QPRESUME,   _VF_ACT_QPRESUME,   _VF_ACT_QPRESUME,   _VF_ACT_QPRESUME,   _VF_ACT_QPRESUME,   _VF_ACT_QPRESUME   },
+    /* _VF_STATE_QPEQUALSC1 */
+    { _VF_ACT_QPESCAPE1,  _VF_ACT_QPESCAPE1,  _VF_ACT_QPESCAPE1,  _VF_ACT_QPESCAPE1,  _VF_ACT_QPESCAPE1,  _VF_ACT_QPESCAPE1,  _VF_ACT_QPESCAPE1,  _VF_ACT_QPESCAPE1  },
+    /* _VF_STATE_QPEQUALSC2 */
+    { _VF_ACT_QPESCAPE2,  _VF_ACT_QPESCAPE2,  _VF_ACT_QPESCAPE2,  _VF_ACT_QPESCAPE2,  _VF_ACT_QPESCAPE2,  _VF_ACT_QPESCAPE2,  _VF_ACT_QPESCAPE2,  _VF_ACT_QPESCAPE2  },
+    /* _VF_STATE_BASE64 */
+    { _VF_ACT_B64RUN,     _VF_ACT_B64EOL,     _VF_ACT_B64REPLAY,  _VF_ACT_B64REPLAY,  _VF_ACT_B64RUN,     _VF_ACT_B64RUN,     _VF_ACT_B64RUN,     _VF_ACT_B64RUN     },
+    /* _VF_STATE_RESYNC */
+    { _VF_ACT_RESYNCRUN,  _VF_ACT_RESYNCEOL,  _VF_ACT_RESYNCRUN,  _VF_ACT_RESYNCRUN,  _VF_ACT_RESYNCRUN,  _VF_ACT_RESYNCRUN,  _VF_ACT_RESYNCRUN,  _VF_ACT_RESYNCRUN  },
+    /* _VF_STATE_RESYNCNL */
+    { _VF_ACT_RESYNCEND,  _VF_ACT_IGNORE,     _VF_ACT_RESYNCEND,  _VF_ACT_RESYNCEND,  _VF_ACT_RESYNCEND,  _VF_ACT_RESYNCEND,  _VF_ACT_RESYNCEND,  _VF_ACT_RESYNCFOLD }
+};
+
+/*
+ * Value of each BASE64 character.  Anything outside the alphabet decodes as
+ * zero, padding is flagged with _VF_B64_PAD.
+ */
+static const uint8_t base64_value[256] =
+{
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3E, 0x00, 0x00, 0x00, 0x3F,
+    0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00,
+    0x00, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E,
+    0x0F, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2A, 0x2B, 0x2C, 0x2D, 0x2E, 0x2F, 0x30, 0x31, 0x32, 0x33, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+};
+
+/*
+ * Value of each hex digit, _VF_HEX_BAD for anything else.
+ */
+static const uint8_t hex_value[256] =
+{
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
+};
 
 /*============================================================================*
  Public Function Implementations
@@ -293,6 +605,213 @@ bool_t vf_parse_init(
     return ret;
 }
 
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      vf_parse_init_arena()
+ * 
+ * DESCRIPTION
+ *      Initialise a parsing instance which builds the tree in an arena.  The
+ *      parser holds a reference on the arena till vf_parse_end().
+ *
+ * RETURNS
+ *      TRUE iff parser allocated successfully.
+ *---------------------------------------------------------------------------*/
+
+bool_t vf_parse_init_arena(
+    VF_PARSER_T **pp_parser,    /* The parser */
+    VF_OBJECT_T **pp_object,    /* The object we're parsing into */
+    uint32_t size_hint          /* Expected size of the tree, 0 if unknown */
+    )
+{
+    bool_t ret = vf_parse_init(pp_parser, pp_object);
+
+    if (ret)
+    {
+        VPARSE_T *p_parse = (VPARSE_T *)*pp_parser;
+
+        p_parse->p_arena = arena_create(size_hint);
+
+        if (!p_parse->p_arena)
+        {
+            vf_free(p_parse);
+
+            *pp_parser = NULL;
+
+            ret = FALSE;
+        }
+    }
+
+    return ret;
+}
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      vf_parse_init_callback()
+ * 
+ * DESCRIPTION
+ *      Initialise a parsing instance which passes each top level object to
+ *      a callback once complete.
+ *
+ * RETURNS
+ *      TRUE iff parser allocated successfully.
+ *---------------------------------------------------------------------------*/
+
+bool_t vf_parse_init_callback(
+    VF_PARSER_T **pp_parser,        /* The parser */
+    vf_parse_callback_t p_callback, /* Called with each top level object */
+    uint32_t n_context,             /* Callback context */
+    void *p_context                 /* A bit more callback context */
+    )
+{
+    bool_t ret = FALSE;
+    VF_OBJECT_T *p_object;
+
+    if (p_callback && vf_parse_init(pp_parser, &p_object))
+    {
+        VPARSE_T *p_parse = (VPARSE_T *)*pp_parser;
+
+        p_parse->pp_root_object = &(p_parse->p_cbroot);
+        p_parse->p_callback = p_callback;
+        p_parse->n_cbcontext = n_context;
+        p_parse->p_cbcontext = p_context;
+
+        ret = TRUE;
+    }
+
+    return ret;
+}
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      vf_parse_set_flags()
+ * 
+ * DESCRIPTION
+ *      Set flags (VFPF_xxx) altering the behaviour of a parser.
+ *
+ * RETURNS
+ *      TRUE <=> flags set, FALSE else.
+ *---------------------------------------------------------------------------*/
+
+bool_t vf_parse_set_flags(
+    VF_PARSER_T *p_parser,      /* The parser */
+    vf_parse_flags_t flags      /* VFPF_xxx flags */
+    )
+{
+    VPARSE_T *p_parse = (VPARSE_T *)p_parser;
+
+    if (p_parse)
+    {
+        p_parse->flags = flags;
+    }
+
+    return (bool_t)(NULL != p_parse);
+}
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      vf_parse_set_filter()
+ * 
+ * DESCRIPTION
+ *      Set the list of property names a parser keeps (allow) or drops (!allow).
+ *      Names in the list which are atoms are shared, the rest copied.
+ *
+ * RETURNS
+ *      TRUE <=> allocation OK, FALSE else.
+ *---------------------------------------------------------------------------*/
+
+bool_t vf_parse_set_filter(
+    VF_PARSER_T *p_parser,      /* The parser */
+    const char **pp_names,      /* NULL terminated list, NULL for none */
+    bool_t allow                /* Keep only these or drop these? */
+    )
+{
+    bool_t ok = FALSE;
+    VPARSE_T *p_parse = (VPARSE_T *)p_parser;
+
+    if (p_parse)
+    {
+        uint32_t n;
+
+        free_filter(p_parse);
+
+        for (n = 0;pp_names && pp_names[n];n++)
+        {
+            /* Count */
+        }
+
+        p_parse->filter_allow = allow;
+
+        ok = TRUE;
+
+        if (n)
+        {
+            p_parse->pp_filter = (const char **)vf_malloc(n * sizeof(char *));
+
+            ok = (bool_t)(NULL != p_parse->pp_filter);
+        }
+
+        for (;ok && (p_parse->n_filter < n);p_parse->n_filter++)
+        {
+            const char *p_name = pp_names[p_parse->n_filter];
+            const char *p_atom = atom_find(p_name, p_strlen(p_name), FALSE);
+            char *p_copy = NULL;
+
+            if (p_atom)
+            {
+                p_parse->pp_filter[p_parse->n_filter] = p_atom;
+            }
+            else
+            if (append_to_pointer(&p_copy, NULL, p_name, p_strlen(p_name)))
+            {
+                p_parse->pp_filter[p_parse->n_filter] = p_copy;
+            }
+            else
+            {
+                ok = FALSE;
+                break;
+            }
+        }
+
+        if (!ok)
+        {
+            free_filter(p_parse);
+        }
+    }
+
+    return ok;
+}
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      vf_parse_set_diagnostics()
+ * 
+ * DESCRIPTION
+ *      Have a parser record its errors in the caller's structure.
+ *
+ * RETURNS
+ *      TRUE <=> diagnostics set, FALSE else.
+ *---------------------------------------------------------------------------*/
+
+bool_t vf_parse_set_diagnostics(
+    VF_PARSER_T *p_parser,      /* The parser */
+    VF_PARSE_DIAG_T *p_diag     /* Where to record errors, NULL for nowhere */
+    )
+{
+    VPARSE_T *p_parse = (VPARSE_T *)p_parser;
+
+    if (p_parse)
+    {
+        p_parse->p_diag = p_diag;
+
+        if (p_diag)
+        {
+            p_memset(p_diag, '\0', sizeof(VF_PARSE_DIAG_T));
+        }
+    }
+
+    return (bool_t)(NULL != p_parse);
+}
+
 /*----------------------------------------------------------------------------*
  * NAME
  *      vf_parse_text()
@@ -328,262 +847,319 @@ bool_t vf_parse_text(
     for (i = 0, ok = TRUE;ok && (i < numchars);i++)
     {
         char c = p_chars[i];
+        bool_t again;
 
-        switch (p_parse->state)
+        if (p_parse->p_view_seal)
         {
-        case _VF_STATE_RFC822VALUEFOLD:
-            {
-                if (ISCRORNL(c))
-                {
-                    /* Ignore */
-                }
-                else
-                if ((SPACE == c) || (TAB == c))
-                {
-                    /* Ignore leading white space characters when unfolding */
+            /* We've read the character after the view, terminate it */
 
-                    p_parse->state = _VF_STATE_RFC822VALUE;
-                }
-                else
-                {
-                    ok = handle_value_complete(p_parse);
+            *(p_parse->p_view_seal) = '\0';
+            p_parse->p_view_seal = NULL;
+        }
 
-                    p_parse->state = _VF_STATE_PROPNAME;
-                }
-            }
-            if (_VF_STATE_PROPNAME == p_parse->state)
-            {
-                /* Fall through */
-            }
-            else
+        /*
+         * An action may end a state & pass the character on to the next.
+         */
+        for (again = TRUE;ok && again;)
+        {
+            again = FALSE;
+
+            switch (lex_action[p_parse->state][lex_class[(uint8_t)c]])
             {
+            case _VF_ACT_IGNORE:
                 break;
-            }
 
-            /* Fall through */
-            
-
-        case _VF_STATE_PROPNAME:
-            {
-                if (COLON == c)
+            case _VF_ACT_NAMERUN:
+            case _VF_ACT_NAMEFIELD:
+            case _VF_ACT_NAMEGROUP:
+            case _VF_ACT_NAMEEND:
+            case _VF_ACT_NAMEESCAPE:
+            case _VF_ACT_NAMEEOL:
+            case _VF_ACT_ESCAPED:
+            case _VF_ACT_NAMEERROR:
                 {
-                    p_parse->prop.value.encoding = deduce_encoding(&p_parse->prop.name);
+                    uint32_t used;
 
-                    switch (p_parse->prop.value.encoding)
-                    {
-                    case VF_ENC_7BIT:
-                        p_parse->state = _VF_STATE_RFC822VALUE;
-                        break;
-
-                    case VF_ENC_BASE64:
-                        p_parse->state = _VF_STATE_BASE64;
-                        break;
-
-                    case VF_ENC_QUOTEDPRINTABLE:
-                        p_parse->state = _VF_STATE_QPIDLE;
-                        break;
+                    ok = handle_name_chars(p_parse, c, p_chars + i, numchars - i, &used);
 
-                    default:
-                        ok = FALSE;
-                        break;
-                    }
+                    i += used - 1;
                 }
-                else
-                if (BACKSLASH == c)
+                break;
+
+            case _VF_ACT_VALUEEOL:
+                if (!p_parse->skip)
                 {
-                    p_parse->state = _VF_STATE_PROPNAMEESCAPE;
+                    ok = start_value_string(p_parse);
                 }
-                else
-                if (ISCRORNL(c))
-                {
-                    /* ignore */
 
-                    free_string_array_contents(&p_parse->prop.name);
-                }
-                else
-                if (SEMICOLON == c)
+                p_parse->state = _VF_STATE_RFC822VALUEFOLD;
+                break;
+
+            case _VF_ACT_VALUEFIELD:
+                if (!p_parse->skip)
                 {
-                    ok = add_string_to_array(&p_parse->prop.name, "");
+                    ok = (bool_t)(start_value_string(p_parse) &&
+                        add_string_to_array(&(p_parse->prop.value.v.s), NULL));
+                    break;
                 }
-                else
-                if (PERIOD == c)
+
+                /* Skipped with the rest of the line */
+                /* Fall through */
+
+            case _VF_ACT_VALUERUN:
+                if (p_parse->skip)
                 {
-                    ok = append_group_name(&p_parse->prop);
+                    i += span_length(p_chars + i, numchars - i, _VF_CC_CRLF) - 1;
                 }
                 else
                 {
-                    ok = append_to_curr_string(&(p_parse->prop.name), NULL, &c, 1);
-                }
-            }
-            break;
+                    uint32_t run = span_length(p_chars + i, numchars - i, _VF_CC_VALUEDELIMS);
 
-        case _VF_STATE_PROPNAMEESCAPE:
-            {
-                if (SEMICOLON == c)
-                {
-                    ok = append_to_curr_string(&(p_parse->prop.name), NULL, &c, 1);
-                }
-                else
-                {
-                    ok = FALSE;
-                }
-            }
-            break;
+                    ok = (bool_t)(start_value_string(p_parse) &&
+                        append_chars(p_parse, &(p_parse->prop.value.v.s), p_chars + i, run));
 
-        case _VF_STATE_RFC822VALUE:
-            {
-                if (p_parse->prop.value.v.s.pp_strings)
-                {
-                    /* Already allocated */
-                }
-                else
-                {
-                    ok = add_string_to_array(&(p_parse->prop.value.v.s), NULL);
+                    i += run - 1;
                 }
+                break;
 
-                if (ISCRORNL(c))
-                {
-                    p_parse->state = _VF_STATE_RFC822VALUEFOLD;
-                }
-                else
-                if (SEMICOLON == c)
+            case _VF_ACT_UNFOLD:
+                /* Ignore leading white space characters when unfolding */
+
+                p_parse->state = _VF_STATE_RFC822VALUE;
+                break;
+
+            case _VF_ACT_VALUEEND:
+                ok = handle_value_complete(p_parse);
+                again = TRUE;
+                break;
+
+            case _VF_ACT_QPEOL:
+                if (!p_parse->prop.value.lazy && !p_parse->skip)
                 {
-                    ok = add_string_to_array(&(p_parse->prop.value.v.s), NULL);
+                    ok = start_value_string(p_parse);
                 }
-                else
+
+                if (ok)
                 {
-                    ok = append_to_curr_string(&(p_parse->prop.value.v.s), NULL, &c, 1);
+                    ok = handle_value_complete(p_parse);
                 }
-            }
-            break;
+                break;
 
-        case _VF_STATE_QPIDLENL:
-            {
-                if (ISCRORNL(c))
+            case _VF_ACT_QPFIELD:
+                if (!p_parse->prop.value.lazy && !p_parse->skip)
                 {
+                    ok = (bool_t)(start_value_string(p_parse) &&
+                        add_string_to_array(&(p_parse->prop.value.v.s), NULL));
                     break;
                 }
-                else
-                {
-                    p_parse->state = _VF_STATE_QPIDLE;
-                }
-            }            
 
-        case _VF_STATE_QPIDLE:
-            {
-                if (p_parse->prop.value.v.s.pp_strings)
-                {
-                    /* Already allocated */
-                }
-                else
-                {
-                    ok = add_string_to_array(&(p_parse->prop.value.v.s), NULL);
-                }
+                /* Kept with the rest of the text */
+                /* Fall through */
 
-                if (EQUALS == c)
+            case _VF_ACT_QPRUN:
                 {
-                    p_parse->qpchar = 0x00;
-                    p_parse->state = _VF_STATE_QPEQUALSC1;
+                    uint32_t used = 1;
+
+                    if (p_parse->prop.value.lazy || p_parse->skip)
+                    {
+                        ok = capture_qp_chars(p_parse, p_chars + i, numchars - i, &used);
+                    }
+                    else
+                    {
+                        ok = (bool_t)(start_value_string(p_parse) &&
+                            handle_qp_chars(p_parse, p_chars + i, numchars - i, &used));
+                    }
+
+                    i += used - 1;
                 }
-                else
-                if (SEMICOLON == c)
+                break;
+
+            case _VF_ACT_QPRESUME:
+                p_parse->state = _VF_STATE_QPIDLE;
+                again = TRUE;
+                break;
+
+            case _VF_ACT_QPESCAPE1:
                 {
-                    ok = add_string_to_array(&(p_parse->prop.value.v.s), NULL);
+                    uint8_t nibble = hex_value[(uint8_t)c];
+
+                    if (p_parse->prop.value.lazy)
+                    {
+                        ok = append_to_buffer(&(p_parse->prop.value.v.b.p_buffer), &(p_parse->prop.value.v.b.n_bufsize), &(p_parse->prop.value.v.b.n_alloc), &c, 1, FALSE);
+                    }
+
+                    if (ISCRORNL(c))
+                    {
+                        p_parse->state = _VF_STATE_QPIDLENL;
+                    }
+                    else
+                    if (_VF_HEX_BAD != nibble)
+                    {
+                        (p_parse->qpchar) <<= 4;
+                        (p_parse->qpchar) |= nibble;
+
+                        p_parse->state = _VF_STATE_QPEQUALSC2;
+                    }
+                    else
+                    {
+                        p_parse->p_error = p_chars + i;
+                        ok = FALSE;
+                    }
                 }
-                else
-                if (ISCRORNL(c))
+                break;
+
+            case _VF_ACT_QPESCAPE2:
                 {
-                    ok = handle_value_complete(p_parse);
+                    uint8_t nibble = hex_value[(uint8_t)c];
+
+                    if ((_VF_HEX_BAD != nibble) && p_parse->prop.value.lazy)
+                    {
+                        ok = append_to_buffer(&(p_parse->prop.value.v.b.p_buffer), &(p_parse->prop.value.v.b.n_bufsize), &(p_parse->prop.value.v.b.n_alloc), &c, 1, FALSE);
+
+                        p_parse->state = _VF_STATE_QPIDLE;
+                    }
+                    else
+                    if ((_VF_HEX_BAD != nibble) && p_parse->skip)
+                    {
+                        p_parse->state = _VF_STATE_QPIDLE;
+                    }
+                    else
+                    if (_VF_HEX_BAD != nibble)
+                    {
+                        (p_parse->qpchar) <<= 4;
+                        (p_parse->qpchar) |= nibble;
+
+                        ok = append_to_curr_string(&(p_parse->prop.value.v.s), NULL, &(p_parse->qpchar), 1);
+
+                        p_parse->state = _VF_STATE_QPIDLE;
+                    }
+                    else
+                    {
+                        p_parse->p_error = p_chars + i;
+                        ok = FALSE;
+                    }
                 }
-                else
+                break;
+
+            /*
+             * The cr/nl stuff associated with line ends & termination of BASE64 encoding
+             * seems to be particularly problematic.  Searching and reading vCards from the
+             * internet shows that all sorts of wierd things are out there in use!  In the 
+             * interests of interoperability we look for the next value as an indication of
+             * the end of the object.  Each line is decoded when we reach its end, lines
+             * split across calls being buffered first.  If we find a ':' or ';' instead
+             * the line is probably something like "NEXT-VALUE:" so we replay it as the
+             * name of the next property.
+             */
+            case _VF_ACT_B64EOL:
+                if (p_parse->n_line)
                 {
-                    ok = append_to_curr_string(&(p_parse->prop.value.v.s), NULL, &c, 1);
+                    ok = handle_base64_chars(p_parse, p_parse->p_line, p_parse->n_line);
+
+                    p_parse->n_line = 0;
                 }
-            }
-            break;
+                break;
 
-        case _VF_STATE_QPEQUALSC1:
-            {
-                uint8_t nibble;
+            case _VF_ACT_B64REPLAY:
+                ok = (bool_t)(append_to_buffer(&(p_parse->p_line), &(p_parse->n_line), &(p_parse->n_linealloc), &c, 1, FALSE) &&
+                    replay_base64_line(p_parse));
+                break;
 
-                if (ISCRORNL(c))
+            case _VF_ACT_B64RUN:
                 {
-                    p_parse->state = _VF_STATE_QPIDLENL;
+                    uint32_t run = span_length(p_chars + i, numchars - i, _VF_CC_BASE64DELIMS);
+
+                    if (!p_parse->n_line && (i + run < numchars) && ISCRORNL(p_chars[i + run]))
+                    {
+                        /* Whole line is here, no need to buffer it */
+
+                        ok = handle_base64_chars(p_parse, p_chars + i, run);
+                    }
+                    else
+                    {
+                        ok = append_to_buffer(&(p_parse->p_line), &(p_parse->n_line), &(p_parse->n_linealloc), p_chars + i, run, FALSE);
+                    }
+
+                    i += run - 1;
                 }
-                else
-                if (is_hex_digit(&nibble, c))
+                break;
+
+            /*
+             * Skip the rest of the line holding an error.  A line ending in
+             * '=' may be a QP soft line break so we skip the next too.
+             */
+            case _VF_ACT_RESYNCRUN:
                 {
-                    (p_parse->qpchar) <<= 4;
-                    (p_parse->qpchar) |= nibble;
+                    uint32_t run = span_length(p_chars + i, numchars - i, _VF_CC_CRLF);
 
-                    p_parse->state = _VF_STATE_QPEQUALSC2;
+                    p_parse->qpchar = (1 < run) ? p_chars[i + run - 1] : c;
+
+                    i += run - 1;
                 }
-                else
+                break;
+
+            case _VF_ACT_RESYNCEOL:
+                if (EQUALS != p_parse->qpchar)
                 {
-                    ok = FALSE;
+                    p_parse->state = _VF_STATE_RESYNCNL;
                 }
-            }
-            break;
+                break;
 
-        case _VF_STATE_QPEQUALSC2:
-            {
-                uint8_t nibble;
+            case _VF_ACT_RESYNCFOLD:
+                /* Folded, still part of the line in error */
 
-                if (is_hex_digit(&nibble, c))
-                {
-                    (p_parse->qpchar) <<= 4;
-                    (p_parse->qpchar) |= nibble;
+                p_parse->qpchar = c;
+                p_parse->state = _VF_STATE_RESYNC;
+                break;
 
-                    ok = append_to_curr_string(&(p_parse->prop.value.v.s), NULL, &(p_parse->qpchar), 1);
+            case _VF_ACT_RESYNCEND:
+                p_parse->state = _VF_STATE_PROPNAME;
+                again = TRUE;
+                break;
+            }
+        }
 
-                    p_parse->state = _VF_STATE_QPIDLE;
-                }
-                else
+        if (!ok && p_parse->p_error)
+        {
+            if (p_parse->p_diag)
+            {
+                const char *p_error = p_parse->p_error;
+                uint32_t offset = p_parse->n_offset + (((p_error >= p_chars) && (p_error < p_chars + numchars)) ? (uint32_t)(p_error - p_chars) : i);
+
+                if (!p_parse->p_diag->n_errors)
                 {
-                    ok = FALSE;
+                    p_parse->p_diag->first_offset = offset;
                 }
+
+                p_parse->p_diag->last_offset = offset;
+                p_parse->p_diag->n_errors++;
             }
-            break;
 
-        case _VF_STATE_BASE64:
+            if (p_parse->flags & VFPF_RECOVER)
             {
-                /*
-                 * The cr/nl stuff associated with line ends & termination of BASE64 encoding
-                 * seems to be particularly problematic.  Searching and reading vCards from the
-                 * internet shows that all sorts of wierd things are out there in use!  In the 
-                 * interests of interoperability we look for the next value as an indication of
-                 * the end of the object.  We build up each line and if it's still in BASE64
-                 * format append the decoded data.  Otherwise we use the parser recursively to
-                 * decode the buffered text, which is probably something like "NEXT-VALUE:"
-                 */
-
-                if (ISCRORNL(c))
-                {
-                    if (p_parse->p_b64buf)
-                    {
-                        ok = handle_base64_chars(p_parse, p_parse->p_b64buf, p_strlen(p_parse->p_b64buf));
+                i = resync_after_error(p_parse, c, p_chars, numchars, i);
 
-                        vf_free(p_parse->p_b64buf);
-                        p_parse->p_b64buf = NULL;
-                    }
-                }
-                else
-                {
-                    ok = append_to_pointer(&(p_parse->p_b64buf), NULL, &c, 1);
+                ok = TRUE;
+            }
+        }
+    }
 
-                    if ((COLON == c) || (SEMICOLON == c))
-                    {
-                        ok = handle_value_complete(p_parse);
+    p_parse->n_offset += numchars;
 
-                        ok = vf_parse_text(p_parser, p_parse->p_b64buf, (uint16_t)p_strlen(p_parse->p_b64buf));
+    if (p_parse->p_view_seal)
+    {
+        /*
+         * View runs up to the end of the text so there's nowhere to put the
+         * terminator, we have to copy it after all.
+         */
+        if (ok)
+        {
+            VSTRARRAY_T *p_strarray = p_parse->p_view_strarray;
 
-                        vf_free(p_parse->p_b64buf);
-                        p_parse->p_b64buf = NULL;
-                    }
-                }
-            }
-            break;
+            ok = own_string_array_entry(p_strarray, p_strarray->n_strings - 1);
         }
+
+        p_parse->p_view_seal = NULL;
     }
 
     if (ok)
@@ -592,15 +1168,17 @@ bool_t vf_parse_text(
     }
     else
     {
+        if (p_parse->p_diag && !p_parse->p_error)
+        {
+            p_parse->p_diag->out_of_memory = TRUE;
+        }
+
         vf_delete_object((VF_OBJECT_T *)*(p_parse->pp_root_object), TRUE);
         *(p_parse->pp_root_object) = NULL;
         p_parse->p_object = NULL;
+        p_parse->p_last_root = NULL;
 
-        if (p_parse->p_b64buf)
-        {
-            vf_free(p_parse->p_b64buf);
-            p_parse->p_b64buf = NULL;
-        }
+        p_parse->n_line = 0;
 
         delete_prop_contents((VF_PROP_T *)&p_parse->prop, TRUE);
     }
@@ -633,336 +1211,1117 @@ bool_t vf_parse_end(
     {
         ret = handle_value_complete(p_parse);
 
+        delete_prop_contents((VF_PROP_T *)&p_parse->prop, TRUE);
+
+        free_filter(p_parse);
+
+        if (p_parse->p_cbroot)
+        {
+            /* Never got its END, nobody to give it to */
+
+            vf_delete_object((VF_OBJECT_T *)p_parse->p_cbroot, TRUE);
+        }
+
+        if (p_parse->p_line)
+        {
+            vf_free(p_parse->p_line);
+        }
+
+        if (p_parse->p_arena)
+        {
+            arena_drop_ref(p_parse->p_arena);
+        }
+
         vf_free(p_parse);
     }    
 
     return ret;
 }
 
-/*============================================================================*
- Private Functions
- *===========================================================================*/
-
 /*----------------------------------------------------------------------------*
  * NAME
- *      append_group_name()
+ *      vf_parse_buffer()
  * 
  * DESCRIPTION
- *      After reading a ".", we transfer the segment of name we've read (which
- *      must be the first string <G>) into the group name.  Keep the group name
- *      in one string of "." tokens for simplicity, so we may end up with a
- *      group called "X-PHONE-BOOK.ENTRY.1" etc.
+ *      Parse a complete buffer in place.  Unencoded name and value fields
+ *      are left pointing into the buffer, terminated by overwriting the
+ *      delimiter that follows them.
  *
  * RETURNS
- *      TRUE <=> allocation OK.
+ *      TRUE <=> allocation & syntax OK, FALSE else.
  *---------------------------------------------------------------------------*/
 
-bool_t append_group_name(
-    VPROP_T *p_prop
+bool_t vf_parse_buffer(
+    VF_OBJECT_T **pp_object,    /* The object we're parsing into */
+    char *p_buffer,             /* Caller's buffer, modified */
+    uint32_t length             /* Number of characters in the buffer */
     )
 {
-    bool_t ok = TRUE;
+    bool_t ret = FALSE;
+    VF_PARSER_T *p_parser;
 
-    if (p_prop->p_group)
+    if (p_buffer && vf_parse_init(&p_parser, pp_object))
     {
-        ok &= append_to_pointer(&p_prop->p_group, NULL, ".", 1);
-    }
+        VPARSE_T *p_parse = (VPARSE_T *)p_parser;
 
-    if (ok)
-    {
-        const char *p_string = p_prop->name.pp_strings[0];
+        p_parse->p_view_start = p_buffer;
+        p_parse->p_view_end = p_buffer + length;
 
-        ok &= append_to_pointer(&p_prop->p_group, NULL, p_string, p_strlen(p_string));
+        ret = vf_parse_text(p_parser, p_buffer, length);
 
-        if (ok)
+        if (!vf_parse_end(p_parser))
         {
-            vf_free(p_prop->name.pp_strings[0]);
-            p_prop->name.pp_strings[0] = NULL;
+            ret = FALSE;
         }
     }
 
-    return ok;
+    return ret;
 }
 
 /*----------------------------------------------------------------------------*
  * NAME
- *      handle_value_complete()
+ *      parse_end_at_top_level()
  * 
  * DESCRIPTION
- *      Called when a complete value is parsed.
+ *      Finish parsing a slice of a buffer, see vf_parse_buffer_parallel().
+ *      The next slice starts with a property name at the start of a line,
+ *      so a value waiting for a fold is complete.  We're then between
+ *      objects iff there's no object open and nothing of a name read.
  *
  * RETURNS
- *      (none).
+ *      TRUE <=> allocation & syntax OK, FALSE else.
  *---------------------------------------------------------------------------*/
 
-bool_t handle_value_complete(
-    VPARSE_T *p_parse          /* Current parse state info */
+bool_t parse_end_at_top_level(
+    VF_PARSER_T *p_parser,      /* The parser */
+    bool_t *p_top_level         /* Set TRUE iff slice ended between objects */
     )
 {
-    bool_t ret = TRUE;
-    VOBJECT_T *p_object;
+    bool_t ok = FALSE;
+    VPARSE_T *p_parse = (VPARSE_T *)p_parser;
 
-    /*
-     * If we've got no object open we ignore values until we read a BEGIN at which point
-     * we create a vformat object and start to parse properties into it.  If we subsequently
-     * read a BEGIN we add a property & parse the next vobject into that.  Each time we read
-     * an END we pop the pp_object pointer back up to the owner of the object we're parsing
-     * into.  There should be an easier way of doing this <G> ...
-     */
-     
-    p_object = p_parse->p_object;
+    *p_top_level = FALSE;
 
-    if (p_object)
+    if (p_parse)
     {
-        if (string_array_contains_string(&p_parse->prop.name, NULL, NULL, 0, VFP_BEGIN, TRUE))
-        {
-            char *p_type;
-
-            p_type = p_parse->prop.value.v.s.pp_strings[0];
-            p_parse->prop.value.v.s.pp_strings[0] = NULL;
-
-            delete_prop_contents((VF_PROP_T *)(&(p_parse->prop)), TRUE);
-
-            p_parse->prop.value.encoding = VF_ENC_VOBJECT;
-
-            ret = (bool_t)(add_string_to_array(&(p_parse->prop.name), p_type) &&
-                alloc_sub_object(p_parse, p_type));
-        }
-        else
-        if (string_array_contains_string(&p_parse->prop.name, NULL, NULL, 0, VFP_END, TRUE))
-        {
-            delete_prop_contents((VF_PROP_T *)(&(p_parse->prop)), TRUE);
+        ok = TRUE;
 
-            p_parse->p_object = p_parse->p_object->p_parent;
-        }
-        else
+        if (_VF_STATE_RFC822VALUEFOLD == p_parse->state)
         {
-            ret = append_value_to_object(NULL, p_parse);
+            ok = handle_value_complete(p_parse);
         }
-    }
-    else
-    {
-        if (string_array_contains_string(&p_parse->prop.name, NULL, NULL, 0, VFP_BEGIN, TRUE))
-        {
-            char *p_type;
 
-            p_type = p_parse->prop.value.v.s.pp_strings[0];
-            p_parse->prop.value.v.s.pp_strings[0] = NULL;
+        *p_top_level = (bool_t)(ok &&
+            (_VF_STATE_PROPNAME == p_parse->state) &&
+            !p_parse->p_object &&
+            !p_parse->prop.p_group &&
+            !p_parse->prop.name.n_strings);
 
-            ret = alloc_next_object(p_parse, p_type);
+        if (!vf_parse_end(p_parser))
+        {
+            ok = FALSE;
         }
-
-        delete_prop_contents((VF_PROP_T *)(&(p_parse->prop)), TRUE);
     }
 
-    p_parse->state = _VF_STATE_PROPNAME;
-
-    return ret;
+    return ok;
 }
 
 /*----------------------------------------------------------------------------*
  * NAME
- *      alloc_next_object()
+ *      decode_lazy_value()
  * 
  * DESCRIPTION
- *      Allocate the "next" object, ie. annother vformat tagged to the p_next
- *      pointer to the current one.
+ *      Decode a value left encoded by VFPF_LAZYDECODE.  BASE64 values hold
+ *      whole groups of 4 characters, which are simply converted.  QUOTED-
+ *      PRINTABLE values hold the text after the ':', which is run through
+ *      the QP states of a scratch parser exactly as the value would have
+ *      been had it not been lazy.
  *
  * RETURNS
- *      TRUE iff memory allocated OK, FALSE else OK.
+ *      TRUE <=> allocation & syntax OK, FALSE else.
  *---------------------------------------------------------------------------*/
 
-bool_t alloc_next_object(
-    VPARSE_T *p_parse,          /* Current parse state info */
-    char *p_type                /* Type of object */
+bool_t decode_lazy_value(
+    VPROP_T *p_prop             /* The property */
+    )
+{
+    bool_t ok = TRUE;
+    VARENA_T *p_arena;
+    VBINDATA_T raw;
+
+    if (!p_prop->value.lazy)
+    {
+        return TRUE;
+    }
+
+    p_arena = prop_arena(p_prop);
+    raw = p_prop->value.v.b;
+
+    if (VF_ENC_BASE64 == p_prop->value.encoding)
+    {
+        uint32_t num = raw.n_bufsize / 4;
+        uint8_t *p_out = NULL;
+
+        if (num)
+        {
+            p_out = (uint8_t *)(p_arena ? arena_alloc(p_arena, 3 * num) : vf_malloc(3 * num));
+
+            ok = (bool_t)(NULL != p_out);
+        }
+
+        if (ok)
+        {
+            p_prop->value.v.b.p_buffer = (char *)p_out;
+            p_prop->value.v.b.n_bufsize = p_out ? decode_base64_quads((const uint8_t *)raw.p_buffer, num, p_out) : 0;
+            p_prop->value.v.b.n_alloc = 3 * num;
+        }
+    }
+    else
+    {
+        VPARSE_T parse;
+        VOBJECT_T *p_root = NULL;
+
+        p_memset(&parse, '\0', sizeof(VPARSE_T));
+
+        parse.state = _VF_STATE_QPIDLE;
+        parse.pp_root_object = &p_root;
+
+        ok = (bool_t)(add_string_to_array(&(parse.prop.value.v.s), NULL) &&
+            vf_parse_text((VF_PARSER_T *)&parse, raw.p_buffer, raw.n_bufsize));
+
+        if (ok)
+        {
+            /* The strings come from the heap, even in an arena tree */
+
+            arena_note_heap_use(p_prop);
+
+            p_prop->value.v.s = parse.prop.value.v.s;
+            p_memset(&(parse.prop.value.v.s), '\0', sizeof(VSTRARRAY_T));
+
+            p_prop->value.v.b.p_buffer = NULL;
+            p_prop->value.v.b.n_bufsize = 0;
+            p_prop->value.v.b.n_alloc = 0;
+        }
+
+        if (parse.p_line)
+        {
+            vf_free(parse.p_line);
+        }
+
+        delete_prop_contents((VF_PROP_T *)&(parse.prop), TRUE);
+    }
+
+    if (ok)
+    {
+        arena_free(p_arena, raw.p_buffer);
+
+        p_prop->value.lazy = FALSE;
+    }
+
+    return ok;
+}
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      lazy_value_verbatim()
+ * 
+ * DESCRIPTION
+ *      The writer produces standard BASE64 - the alphabet only, padding in
+ *      the last group & zero bits after the data.  A lazy value which is
+ *      exactly that decodes to data which encodes back to the same text.
+ *      QUOTED-PRINTABLE text could be quoted differently, so never is.
+ *
+ * RETURNS
+ *      TRUE <=> value can be written out verbatim, FALSE else.
+ *---------------------------------------------------------------------------*/
+
+bool_t lazy_value_verbatim(
+    const VPROP_T *p_prop       /* The property */
+    )
+{
+    const uint8_t *p_chars = (const uint8_t *)p_prop->value.v.b.p_buffer;
+    uint32_t n_chars = p_prop->value.v.b.n_bufsize;
+    uint32_t i;
+
+    if (!p_prop->value.lazy || (VF_ENC_BASE64 != p_prop->value.encoding))
+    {
+        return FALSE;
+    }
+
+    for (i = 0;i < n_chars;i++)
+    {
+        if (!base64_value[p_chars[i]] && ('A' != p_chars[i]))
+        {
+            return FALSE;
+        }
+
+        if (base64_value[p_chars[i]] & _VF_B64_PAD)
+        {
+            break;
+        }
+    }
+
+    if (i == n_chars)
+    {
+        return TRUE;
+    }
+
+    /*
+     * Padding, must be "xx==" or "xxx=" ending the value with the bits
+     * of the last character that don't make a whole byte clear.
+     */
+    if (i + 2 == n_chars)
+    {
+        return (bool_t)(('=' == p_chars[i + 1]) && (2 == (i & 3)) &&
+            !(base64_value[p_chars[i - 1]] & 0x0F));
+    }
+
+    if (i + 1 == n_chars)
+    {
+        return (bool_t)((3 == (i & 3)) && !(base64_value[p_chars[i - 1]] & 0x03));
+    }
+
+    return FALSE;
+}
+
+/*============================================================================*
+ Private Functions
+ *===========================================================================*/
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      append_group_name()
+ * 
+ * DESCRIPTION
+ *      After reading a ".", we transfer the segment of name we've read (which
+ *      must be the first string <G>) into the group name.  Keep the group name
+ *      in one string of "." tokens for simplicity, so we may end up with a
+ *      group called "X-PHONE-BOOK.ENTRY.1" etc.
+ *
+ * RETURNS
+ *      TRUE <=> allocation OK.
+ *---------------------------------------------------------------------------*/
+
+bool_t append_group_name(
+    VPROP_T *p_prop
+    )
+{
+    bool_t ok = TRUE;
+
+    if (p_prop->p_group)
+    {
+        ok &= append_to_pointer(&p_prop->p_group, NULL, ".", 1);
+    }
+
+    if (ok && p_prop->name.n_strings && p_prop->name.pp_strings[0])
+    {
+        const char *p_string = p_prop->name.pp_strings[0];
+
+        ok &= append_to_pointer(&p_prop->p_group, NULL, p_string, p_strlen(p_string));
+
+        if (ok)
+        {
+            ok = set_string_array_entry(&p_prop->name, NULL, 0);
+        }
+    }
+    else
+    if (ok && !p_prop->p_group)
+    {
+        /* Nothing before the '.', the group name starts off empty */
+
+        ok = append_to_pointer(&p_prop->p_group, NULL, "", 0);
+    }
+
+    return ok;
+}
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      handle_value_complete()
+ * 
+ * DESCRIPTION
+ *      Called when a complete value is parsed.
+ *
+ * RETURNS
+ *      (none).
+ *---------------------------------------------------------------------------*/
+
+bool_t handle_value_complete(
+    VPARSE_T *p_parse          /* Current parse state info */
+    )
+{
+    bool_t ret = TRUE;
+    VOBJECT_T *p_object;
+
+    /*
+     * If we've got no object open we ignore values until we read a BEGIN at which point
+     * we create a vformat object and start to parse properties into it.  If we subsequently
+     * read a BEGIN we add a property & parse the next vobject into that.  Each time we read
+     * an END we pop the pp_object pointer back up to the owner of the object we're parsing
+     * into.  There should be an easier way of doing this <G> ...
+     */
+     
+    p_object = p_parse->p_object;
+
+    if (p_object)
+    {
+        if (string_array_contains_string(&p_parse->prop.name, NULL, NULL, 0, VFP_BEGIN, TRUE))
+        {
+            char *p_type;
+
+            p_type = take_string_array_entry(&(p_parse->prop.value.v.s), 0);
+
+            delete_prop_contents((VF_PROP_T *)(&(p_parse->prop)), TRUE);
+
+            p_parse->prop.value.encoding = VF_ENC_VOBJECT;
+
+            ret = add_string_to_array(&(p_parse->prop.name), p_type);
+
+            if (ret)
+            {
+                classify_prop_name(&(p_parse->prop));
+
+                ret = alloc_sub_object(p_parse, p_type);
+            }
+        }
+        else
+        if (string_array_contains_string(&p_parse->prop.name, NULL, NULL, 0, VFP_END, TRUE))
+        {
+            delete_prop_contents((VF_PROP_T *)(&(p_parse->prop)), TRUE);
+
+            p_parse->p_object = p_parse->p_object->p_parent;
+
+            if (!p_parse->p_object && p_parse->p_callback)
+            {
+                deliver_object(p_parse);
+            }
+        }
+        else
+        if (p_parse->skip)
+        {
+            delete_prop_contents((VF_PROP_T *)(&(p_parse->prop)), TRUE);
+        }
+        else
+        {
+            if (!p_parse->p_arena)
+            {
+                trim_string_array(&(p_parse->prop.name));
+                trim_string_array(&(p_parse->prop.value.v.s));
+                trim_buffer(&(p_parse->prop.value.v.b.p_buffer), p_parse->prop.value.v.b.n_bufsize, &(p_parse->prop.value.v.b.n_alloc));
+            }
+
+            ret = append_value_to_object(NULL, p_parse);
+        }
+    }
+    else
+    {
+        if (string_array_contains_string(&p_parse->prop.name, NULL, NULL, 0, VFP_BEGIN, TRUE))
+        {
+            char *p_type;
+
+            p_type = take_string_array_entry(&(p_parse->prop.value.v.s), 0);
+
+            ret = alloc_next_object(p_parse, p_type);
+        }
+
+        delete_prop_contents((VF_PROP_T *)(&(p_parse->prop)), TRUE);
+    }
+
+    p_parse->state = _VF_STATE_PROPNAME;
+
+    return ret;
+}
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      start_value_string()
+ * 
+ * DESCRIPTION
+ *      Make sure the value being read has a string to add characters to, so
+ *      that even an empty value has one.
+ *
+ * RETURNS
+ *      TRUE <=> allocation OK, FALSE else.
+ *---------------------------------------------------------------------------*/
+
+bool_t start_value_string(
+    VPARSE_T *p_parse           /* Current parse state info */
+    )
+{
+    if (p_parse->prop.value.v.s.n_strings)
+    {
+        /* Already allocated */
+
+        return TRUE;
+    }
+
+    return add_string_to_array(&(p_parse->prop.value.v.s), NULL);
+}
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      deliver_object()
+ * 
+ * DESCRIPTION
+ *      We've read the END of a top level object, pass it to the callback.
+ *      It's the only object in the list, which is left empty for the next.
+ *
+ * RETURNS
+ *      (none)
+ *---------------------------------------------------------------------------*/
+
+void deliver_object(
+    VPARSE_T *p_parse           /* Current parse state info */
+    )
+{
+    VOBJECT_T *p_object = *(p_parse->pp_root_object);
+
+    *(p_parse->pp_root_object) = NULL;
+    p_parse->p_last_root = NULL;
+
+    if (p_object && !p_parse->p_callback((VF_OBJECT_T *)p_object, p_parse->n_cbcontext, p_parse->p_cbcontext))
+    {
+        vf_delete_object((VF_OBJECT_T *)p_object, TRUE);
+    }
+}
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      alloc_next_object()
+ * 
+ * DESCRIPTION
+ *      Allocate the "next" object, ie. annother vformat tagged to the p_next
+ *      pointer to the current one.
+ *
+ * RETURNS
+ *      TRUE iff memory allocated OK, FALSE else OK.
+ *---------------------------------------------------------------------------*/
+
+bool_t alloc_next_object(
+    VPARSE_T *p_parse,          /* Current parse state info */
+    char *p_type                /* Type of object */
+    )
+{
+    bool_t ok = TRUE;
+    VOBJECT_T *p_parent = p_parse->p_object;
+    VOBJECT_T *p_new = NULL;
+
+    ok = alloc_object(&p_new, p_parent ? p_parent->p_parent : NULL, p_type, p_parse);
+
+    if (ok)
+    {
+        if (*p_parse->pp_root_object)
+        {
+            /* root object already set */
+
+            if (p_new->p_parent)
+            {
+                /* Owned by property */
+            }
+            else
+            {
+                /* Need to tag to end of top list */
+
+                p_parse->p_last_root->p_next = p_new;
+                p_parse->p_last_root = p_new;
+            }
+        }
+        else
+        {
+            *p_parse->pp_root_object = p_new;
+            p_parse->p_last_root = p_new;
+        }
+    }
+
+    return ok;
+}
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      alloc_sub_object()
+ * 
+ * DESCRIPTION
+ *      Allocate "sub" object, ie. annother vformat tagged to the p_object
+ *      pointer of a VPROP_T allocated to contain it.
+ *
+ * RETURNS
+ *      TRUE iff memory allocated OK, FALSE else OK.
+ *---------------------------------------------------------------------------*/
+
+bool_t alloc_sub_object(
+    VPARSE_T *p_parse,          /* Current parse state info */
+    char *p_type                /* Type of object */
+    )
+{
+    bool_t ok = FALSE;
+    VOBJECT_T *p_parent = p_parse->p_object;
+
+    if (p_parent)
+    {
+        VPROP_T *p_tmp;
+
+        ok = append_value_to_object(&p_tmp, p_parse);
+
+        if (ok && p_tmp)
+        {
+            ok = alloc_object(&p_tmp->value.v.o.p_object, p_parent, p_type, p_parse);
+        }
+    }
+
+    return ok;
+}
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      alloc_object()
+ * 
+ * DESCRIPTION
+ *      Allocate & initialise a new VOBJECT_T.  The new element od made the
+ *      current parse target (ie. new properties will be added to it).
+ *
+ * RETURNS
+ *      TRUE <=> allocation went OK, FALSE else.
+ *---------------------------------------------------------------------------*/
+
+bool_t alloc_object(
+    VOBJECT_T **pp_new,     /* Pointer to output pointer */
+    VOBJECT_T *p_parent,    /* Parent of new node */
+    char *p_type,           /* Type of new node */
+    VPARSE_T *p_parse       /* Current parse info */
+    )
+{
+    bool_t ok = TRUE;
+    VOBJECT_T *p_new;
+    
+    if (p_parse->p_arena)
+    {
+        p_new = (VOBJECT_T *)arena_alloc(p_parse->p_arena, sizeof(VOBJECT_T));
+
+        if (p_new && p_type)
+        {
+            char *p_heaptype = p_type;
+
+            p_type = arena_strdup(p_parse->p_arena, p_heaptype);
+
+            vf_free(p_heaptype);
+
+            if (!p_type)
+            {
+                p_new = NULL;
+            }
+        }
+    }
+    else
+    {
+        p_new = (VOBJECT_T *)vf_malloc(sizeof(VOBJECT_T));
+    }
+
+    if (p_new)
+    {
+        p_memset(p_new, '\0', sizeof(VOBJECT_T));
+
+        p_new->p_parent = p_parent;
+        p_new->p_type = p_type;
+
+        if (p_parse->p_arena)
+        {
+            p_new->p_arena = p_parse->p_arena;
+
+            if (!p_parent)
+            {
+                /* Each top level object holds a reference on the arena */
+
+                p_new->p_arena->n_refs++;
+            }
+        }
+
+        p_parse->p_object = p_new;
+
+        *pp_new = p_new;
+    }
+    else
+    {
+        ok = FALSE;
+    }
+
+    return ok;
+}
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      handle_name_chars()
+ * 
+ * DESCRIPTION
+ *      Handle the next character(s) of a property name.  A run of ordinary
+ *      characters is taken in one go.  c is passed separately as p_chars[0]
+ *      may have been overwritten by the terminator of a view.
+ *
+ * RETURNS
+ *      TRUE <=> allocation & syntax OK, FALSE else.
+ *---------------------------------------------------------------------------*/
+
+bool_t handle_name_chars(
+    VPARSE_T *p_parse,          /* Current parse state info */
+    char c,                     /* Next character */
+    char *p_chars,              /* Characters to parse, starting with c */
+    uint32_t numchars,          /* Number of characters available */
+    uint32_t *p_used            /* Number of characters used */
+    )
+{
+    bool_t ok = TRUE;
+
+    *p_used = 1;
+
+    switch (lex_action[p_parse->state][lex_class[(uint8_t)c]])
+    {
+    case _VF_ACT_ESCAPED:
+        ok = append_to_curr_string(&(p_parse->prop.name), NULL, &c, 1);
+        break;
+
+    case _VF_ACT_NAMEERROR:
+        p_parse->p_error = p_chars;
+        ok = FALSE;
+        break;
+
+    case _VF_ACT_NAMEEND:
+        p_parse->prop.value.encoding = classify_prop_name(&p_parse->prop);
+        p_parse->skip = skip_property(p_parse);
+
+        switch (p_parse->prop.value.encoding)
+        {
+        case VF_ENC_7BIT:
+            p_parse->state = _VF_STATE_RFC822VALUE;
+            break;
+
+        case VF_ENC_BASE64:
+            p_parse->state = _VF_STATE_BASE64;
+            p_parse->prop.value.lazy = (bool_t)(!p_parse->skip && (0 != (p_parse->flags & VFPF_LAZYDECODE)));
+            break;
+
+        case VF_ENC_QUOTEDPRINTABLE:
+            p_parse->state = _VF_STATE_QPIDLE;
+            p_parse->prop.value.lazy = (bool_t)(!p_parse->skip && (0 != (p_parse->flags & VFPF_LAZYDECODE)));
+            break;
+
+        default:
+            p_parse->p_error = p_chars;
+            ok = FALSE;
+            break;
+        }
+        break;
+
+    case _VF_ACT_NAMEESCAPE:
+        p_parse->state = _VF_STATE_PROPNAMEESCAPE;
+        break;
+
+    case _VF_ACT_NAMEEOL:
+        /* ignore */
+
+        free_string_array_contents(&p_parse->prop.name);
+        break;
+
+    case _VF_ACT_NAMEFIELD:
+        ok = add_string_to_array(&p_parse->prop.name, "");
+        break;
+
+    case _VF_ACT_NAMEGROUP:
+        ok = append_group_name(&p_parse->prop);
+        break;
+
+    default:
+        {
+            uint32_t run = span_length(p_chars, numchars, _VF_CC_NAMEDELIMS);
+            const char *p_atom = NULL;
+
+            if ((run < numchars) && ((SEMICOLON == p_chars[run]) || (COLON == p_chars[run])))
+            {
+                /* Whole field is here, share the atom if there is one */
+
+                p_atom = atom_find(p_chars, run, TRUE);
+            }
+
+            if (p_atom)
+            {
+                ok = append_view_to_curr_string(&(p_parse->prop.name), (char *)p_atom, run);
+            }
+            else
+            {
+                ok = append_chars(p_parse, &(p_parse->prop.name), p_chars, run);
+            }
+
+            *p_used = run;
+        }
+        break;
+    }
+
+    return ok;
+}
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      handle_base64_chars()
+ * 
+ * DESCRIPTION
+ *      Decode a line of BASE64 straight into the property's binary data.
+ *      Characters outside the alphabet count as zero, '=' padding carries
+ *      no bits & a partial group at the end of the line is ignored.  If the
+ *      value is lazy the whole groups are kept as they are instead, so that
+ *      decode_lazy_value() gets exactly the same result later.
+ *
+ * RETURNS
+ *      TRUE <=> allocation OK, FALSE else.
+ *---------------------------------------------------------------------------*/
+
+bool_t handle_base64_chars(
+    VPARSE_T *p_parse,          /* The property value we're adding to */
+    const char *p_chars,        /* Pointer to characters to add */
+    uint32_t numchars           /* Number of characters */
+    )
+{
+    bool_t ok = TRUE;
+    VBINDATA_T *p_bin = &(p_parse->prop.value.v.b);
+    uint32_t num;
+
+    /*
+     * Skip spaces.
+     */
+    while ((0 < numchars) && (SPACE == p_chars[0]))
+    {
+        numchars--;
+        p_chars++;
+    }
+
+    num = numchars / 4;
+
+    if (p_parse->skip)
+    {
+        /* Value is being dropped */
+    }
+    else
+    if (num && p_parse->prop.value.lazy)
+    {
+        ok = append_to_buffer(&(p_bin->p_buffer), &(p_bin->n_bufsize), &(p_bin->n_alloc), p_chars, 4 * num, FALSE);
+    }
+    else
+    if (num && reserve_buffer(&(p_bin->p_buffer), p_bin->n_bufsize, &(p_bin->n_alloc), 3 * num))
+    {
+        /* Room for the whole line is made up front */
+
+        p_bin->n_bufsize += decode_base64_quads((const uint8_t *)p_chars, num, (uint8_t *)p_bin->p_buffer + p_bin->n_bufsize);
+    }
+    else
+    if (num)
+    {
+        ok = FALSE;
+    }
+
+    return ok;
+}
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      decode_base64_quads()
+ * 
+ * DESCRIPTION
+ *      Convert each group of 4 BASE64 characters to a byte triplet, or
+ *      fewer bytes if the group is padded.
+ *
+ * RETURNS
+ *      Number of bytes written to p_out.
+ *---------------------------------------------------------------------------*/
+
+uint32_t decode_base64_quads(
+    const uint8_t *p_quad,      /* Groups of 4 characters */
+    uint32_t num,               /* Number of groups */
+    uint8_t *p_out              /* Room for 3 * num bytes */
     )
 {
-    bool_t ok = TRUE;
-    VOBJECT_T *p_parent = p_parse->p_object;
-    VOBJECT_T *p_new = NULL;
-
-    ok = alloc_object(&p_new, p_parent ? p_parent->p_parent : NULL, p_type, p_parse);
+    uint8_t *p_start = p_out;
 
-    if (ok)
+    for (;num;num--, p_quad += 4)
     {
-        if (*p_parse->pp_root_object)
-        {
-            /* root object already set */
+        uint8_t v0 = base64_value[p_quad[0]];
+        uint8_t v1 = base64_value[p_quad[1]];
+        uint8_t v2 = base64_value[p_quad[2]];
+        uint8_t v3 = base64_value[p_quad[3]];
+        uint32_t b;
 
-            if (p_new->p_parent)
-            {
-                /* Owned by property */
-            }
-            else
-            {
-                /* Need to tag to end of top list */
+        b = ((uint32_t)(v0 & 0x3F) << 18) | ((uint32_t)(v1 & 0x3F) << 12) |
+            ((uint32_t)(v2 & 0x3F) << 6) | (uint32_t)(v3 & 0x3F);
 
-                VOBJECT_T **pp_tmp = p_parse->pp_root_object;
+        p_out[0] = (uint8_t)(b >> 16);
+        p_out[1] = (uint8_t)(b >> 8);
+        p_out[2] = (uint8_t)(b);
 
-                while (*pp_tmp)
-                {
-                    pp_tmp = &((*pp_tmp)->p_next);
-                }
+        if ((v0 | v1 | v2 | v3) & _VF_B64_PAD)
+        {
+            /* Only whole bytes from the 6 bits of each non-pad character */
 
-                *pp_tmp = p_new;
-            }
+            uint32_t pads = (v0 >> 7) + (v1 >> 7) + (v2 >> 7) + (v3 >> 7);
+
+            p_out += ((4 - pads) * 6) / 8;
         }
         else
         {
-            *p_parse->pp_root_object = p_new;
+            p_out += 3;
         }
     }
 
-    return ok;
+    return (uint32_t)(p_out - p_start);
 }
 
 /*----------------------------------------------------------------------------*
  * NAME
- *      alloc_sub_object()
+ *      replay_base64_line()
  * 
  * DESCRIPTION
- *      Allocate "sub" object, ie. annother vformat tagged to the p_object
- *      pointer of a VPROP_T allocated to contain it.
+ *      The buffered line turned out to be the name of the next property.
+ *      Complete the BASE64 value and parse the line as a name.
  *
  * RETURNS
- *      TRUE iff memory allocated OK, FALSE else OK.
+ *      TRUE <=> allocation & syntax OK, FALSE else.
  *---------------------------------------------------------------------------*/
 
-bool_t alloc_sub_object(
-    VPARSE_T *p_parse,          /* Current parse state info */
-    char *p_type                /* Type of object */
+bool_t replay_base64_line(
+    VPARSE_T *p_parse           /* Current parse state info */
     )
 {
-    bool_t ok = FALSE;
-    VOBJECT_T *p_parent = p_parse->p_object;
+    uint32_t i, used;
+    bool_t ok = handle_value_complete(p_parse);
 
-    if (p_parent)
+    for (i = 0;ok && (i < p_parse->n_line);i += used)
     {
-        VPROP_T *p_tmp;
-
-        ok = append_value_to_object(&p_tmp, p_parse);
-
-        if (ok && p_tmp)
-        {
-            ok = alloc_object(&p_tmp->value.v.o.p_object, p_parent, p_type, p_parse);
-        }
+        ok = handle_name_chars(p_parse, p_parse->p_line[i], p_parse->p_line + i, p_parse->n_line - i, &used);
     }
 
+    p_parse->n_line = 0;
+
     return ok;
 }
 
 /*----------------------------------------------------------------------------*
  * NAME
- *      alloc_object()
+ *      handle_qp_chars()
  * 
  * DESCRIPTION
- *      Allocate & initialise a new VOBJECT_T.  The new element od made the
- *      current parse target (ie. new properties will be added to it).
+ *      Decode QUOTED-PRINTABLE text up to the next ';' or line end.  Runs of
+ *      literal characters, "=XX" escapes and soft line breaks are decoded
+ *      into a workspace of up to QPDECODEBLOCK bytes, which is added to the
+ *      current string each time it fills & at the end.  Text from
+ *      a vf_parse_buffer() buffer is decoded in place instead, the output is
+ *      never longer than the input.  An escape or line break split across
+ *      calls is left to the QPEQUALSC1, QPEQUALSC2 & QPIDLENL states.
  *
  * RETURNS
- *      TRUE <=> allocation went OK, FALSE else.
+ *      TRUE <=> allocation & syntax OK, FALSE else.
  *---------------------------------------------------------------------------*/
 
-bool_t alloc_object(
-    VOBJECT_T **pp_new,     /* Pointer to output pointer */
-    VOBJECT_T *p_parent,    /* Parent of new node */
-    char *p_type,           /* Type of new node */
-    VPARSE_T *p_parse       /* Current parse info */
+bool_t handle_qp_chars(
+    VPARSE_T *p_parse,          /* Current parse state info */
+    char *p_chars,              /* Characters to parse */
+    uint32_t numchars,          /* Number of characters available */
+    uint32_t *p_used            /* Number of characters used */
     )
 {
     bool_t ok = TRUE;
-    VOBJECT_T *p_new;
-    
-    p_new = (VOBJECT_T *)vf_malloc(sizeof(VOBJECT_T));
+    bool_t in_place = (bool_t)(p_parse->p_view_start && (p_parse->p_view_start <= p_chars) && (p_chars + numchars <= p_parse->p_view_end));
+    uint32_t room = (in_place || (numchars < QPDECODEBLOCK)) ? numchars : QPDECODEBLOCK;
+    char *p_start;
+    char *p_out;
+    uint32_t i = 0;
 
-    if (p_new)
+    if (in_place)
     {
-        p_memset(p_new, '\0', sizeof(VOBJECT_T));
+        p_start = p_chars;
+    }
+    else
+    if (reserve_buffer(&(p_parse->p_line), 0, &(p_parse->n_linealloc), room))
+    {
+        p_start = p_parse->p_line;
+    }
+    else
+    {
+        return FALSE;
+    }
 
-        p_new->p_parent = p_parent;
-        p_new->p_type = p_type;
+    for (p_out = p_start;ok && (i < numchars);)
+    {
+        uint32_t left = room - (uint32_t)(p_out - p_start);
+        uint32_t run;
 
-        p_parse->p_object = p_new;
+        if (!left)
+        {
+            /* Workspace full, add it to the value & start again */
 
-        *pp_new = p_new;
+            ok = append_chars(p_parse, &(p_parse->prop.value.v.s), p_start, room);
+            p_out = p_start;
+            continue;
+        }
+
+        run = span_length(p_chars + i, ((numchars - i) < left) ? (numchars - i) : left, _VF_CC_QPDELIMS);
+
+        if (run)
+        {
+            if (!in_place)
+            {
+                p_memcpy(p_out, p_chars + i, run);
+            }
+            else
+            if (p_out != p_chars + i)
+            {
+                /* Output trails input after an escape, copy forwards */
+
+                uint32_t j;
+
+                for (j = 0;j < run;j++)
+                {
+                    p_out[j] = p_chars[i + j];
+                }
+            }
+
+            p_out += run;
+            i += run;
+        }
+        else
+        if (EQUALS != p_chars[i])
+        {
+            /* ';' or line end, left to the caller */
+
+            break;
+        }
+        else
+        if (i + 1 == numchars)
+        {
+            p_parse->qpchar = 0x00;
+            p_parse->state = _VF_STATE_QPEQUALSC1;
+            i++;
+        }
+        else
+        if (ISCRORNL(p_chars[i + 1]))
+        {
+            /* Soft line break */
+
+            for (i += 2;(i < numchars) && ISCRORNL(p_chars[i]);i++)
+            {
+                /* Skip */
+            }
+
+            if (i == numchars)
+            {
+                p_parse->state = _VF_STATE_QPIDLENL;
+            }
+        }
+        else
+        {
+            uint8_t hi = hex_value[(uint8_t)p_chars[i + 1]];
+            uint8_t lo = (i + 2 < numchars) ? hex_value[(uint8_t)p_chars[i + 2]] : 0x00;
+
+            if ((_VF_HEX_BAD == hi) || (_VF_HEX_BAD == lo))
+            {
+                p_parse->p_error = p_chars + i + ((_VF_HEX_BAD == hi) ? 1 : 2);
+                ok = FALSE;
+            }
+            else
+            if (i + 2 == numchars)
+            {
+                p_parse->qpchar = (char)hi;
+                p_parse->state = _VF_STATE_QPEQUALSC2;
+                i += 2;
+            }
+            else
+            {
+                *p_out++ = (char)((hi << 4) | lo);
+                i += 3;
+            }
+        }
     }
-    else
+
+    if (ok && (p_out != p_start))
     {
-        ok = FALSE;
+        ok = append_chars(p_parse, &(p_parse->prop.value.v.s), p_start, (uint32_t)(p_out - p_start));
     }
 
+    *p_used = i;
+
     return ok;
 }
 
 /*----------------------------------------------------------------------------*
  * NAME
- *      handle_base64_chars()
+ *      capture_qp_chars()
  * 
  * DESCRIPTION
- *      Handle BASE64 decoding.
+ *      The lazy version of handle_qp_chars(), keep the text up to the next
+ *      line end as it is.  Complete "=XX" escapes & soft line breaks are
+ *      checked and kept in the same run, an escape split across calls or
+ *      with a bad digit is left to the QPEQUALSC1/C2 states.  Also used to
+ *      step over the value of a property being skipped.
  *
  * RETURNS
  *      TRUE <=> allocation OK, FALSE else.
  *---------------------------------------------------------------------------*/
 
-bool_t handle_base64_chars(
-    VPARSE_T *p_parse,          /* The property value we're adding to */
-    const char *p_chars,        /* Pointer to characters to add */
-    int numchars                /* Number of characters */
+bool_t capture_qp_chars(
+    VPARSE_T *p_parse,          /* Current parse state info */
+    const char *p_chars,        /* Characters to parse */
+    uint32_t numchars,          /* Number of characters available */
+    uint32_t *p_used            /* Number of characters used */
     )
 {
-    bool_t ok = TRUE;
-
-    /*
-     * Skip spaces.
-     */
-    while ((0 < numchars) && (SPACE == p_chars[0]))
-    {
-        numchars--;
-        p_chars++;
-    }
+    VBINDATA_T *p_bin = &(p_parse->prop.value.v.b);
+    uint32_t i = 0;
 
-    /*
-     * Convert groups of 4 characters to byte triplets & append the bytes
-     * to the binary data.
-     */
-    if (0 < numchars)
+    for (;;)
     {
-        int i, j, len, num, left;
-        const char *p_quad;
+        i += span_length(p_chars + i, numchars - i, _VF_CC_CRLF | _VF_CC_EQUALS);
 
-        len = numchars;
-        num = len / 4;
-        left = len % 4;
+        if ((i == numchars) || (EQUALS != p_chars[i]))
+        {
+            /* Line end, left to the caller */
 
-        for (i = 0, p_quad = p_chars;(i < num);i++, p_quad += 4)
+            break;
+        }
+        else
+        if ((i + 1 < numchars) && ISCRORNL(p_chars[i + 1]))
         {
-            uint32_t b;
-            char bytes[3];
-            uint8_t bits;
+            /* Soft line break */
 
-            for (j = 0, b = 0, bits = 0;(j < 4);j++)
+            for (i += 2;(i < numchars) && ISCRORNL(p_chars[i]);i++)
             {
-                b = (b << 6) | base64_to_char(p_quad[j]);
-
-                if (EQUALS != p_quad[j])
-                {
-                    bits += 6;
-                }
+                /* Keep */
             }
 
-            for (j = 0;(j < 3);j++)
+            if (i == numchars)
             {
-                bytes[2 - j] = (unsigned char)(b & 0xFF);
-
-                b >>= 8;
+                p_parse->state = _VF_STATE_QPIDLENL;
+                break;
             }
+        }
+        else
+        if ((i + 2 < numchars) &&
+            (_VF_HEX_BAD != hex_value[(uint8_t)p_chars[i + 1]]) &&
+            (_VF_HEX_BAD != hex_value[(uint8_t)p_chars[i + 2]]))
+        {
+            i += 3;
+        }
+        else
+        {
+            i++;
 
-            ok = append_to_pointer(&(p_parse->prop.value.v.b.p_buffer), &(p_parse->prop.value.v.b.n_bufsize), bytes, bits / 8L);
+            p_parse->qpchar = 0x00;
+            p_parse->state = _VF_STATE_QPEQUALSC1;
+            break;
         }
     }
 
-    return ok;
+    *p_used = i;
+
+    if (p_parse->skip)
+    {
+        return TRUE;
+    }
+
+    return append_to_buffer(&(p_bin->p_buffer), &(p_bin->n_bufsize), &(p_bin->n_alloc), p_chars, i, FALSE);
 }
 
 /*----------------------------------------------------------------------------*
@@ -986,21 +2345,55 @@ bool_t append_value_to_object(
 
     VPROP_T **pp_tmp;
     VPROP_T *p_prop;
+    VOBJECT_T *p_object = p_parse->p_object;
 
-    pp_tmp = &(p_parse->p_object->p_props);
-
-    while (*pp_tmp)
+    if (p_object->p_last_prop)
+    {
+        pp_tmp = &(p_object->p_last_prop->p_next);
+    }
+    else
     {
-        pp_tmp = &((*pp_tmp)->p_next);
+        for (pp_tmp = &(p_object->p_props);*pp_tmp;pp_tmp = &((*pp_tmp)->p_next))
+        {
+            /* Find the end */
+        }
     }
 
-    *pp_tmp = p_prop = (VPROP_T *)vf_malloc(sizeof(VPROP_T));
+    if (p_parse->p_arena)
+    {
+        *pp_tmp = p_prop = (VPROP_T *)arena_alloc(p_parse->p_arena, sizeof(VPROP_T));
+    }
+    else
+    {
+        *pp_tmp = p_prop = (VPROP_T *)vf_malloc(sizeof(VPROP_T));
+    }
 
     if (pp_prop)
     {
         *pp_prop = p_prop;
     }
 
+    if (p_prop && p_parse->p_arena)
+    {
+        /*
+         * Move the contents into the arena, the scratch property keeps its
+         * slot arrays for the next property.
+         */
+        p_memset(p_prop, '\0', sizeof(VPROP_T));
+
+        p_prop->value.encoding = p_parse->prop.value.encoding;
+        p_prop->value.lazy = p_parse->prop.value.lazy;
+        p_prop->qualifiers = p_parse->prop.qualifiers;
+        p_prop->n_charset = p_parse->prop.n_charset;
+        p_prop->n_encoding = p_parse->prop.n_encoding;
+        p_prop->p_parent = p_parse->p_object;
+
+        ok = arena_adopt_prop(p_parse->p_arena, p_prop, &(p_parse->prop));
+
+        p_parse->prop.value.encoding = VF_ENC_UNKNOWN;
+        p_parse->prop.value.lazy = FALSE;
+    }
+    else
     if (p_prop)
     {
         p_memset(p_prop, '\0', sizeof(VPROP_T));
@@ -1014,114 +2407,225 @@ bool_t append_value_to_object(
         ok = TRUE;
     }
 
+    if (p_prop)
+    {
+        p_object->p_last_prop = p_prop;
+    }
+
     return ok;
 }
 
 /*----------------------------------------------------------------------------*
  * NAME
- *      deduce_encoding()
+ *      skip_property()
  * 
  * DESCRIPTION
- *      Check property name for encoding tags.  If none present, return the
- *      default encoding.
+ *      Called once a property's name & encoding are known to see if its
+ *      value should be dropped, either because it's binary and VFPF_SKIPBINARY
+ *      is set or because of the filter.  BEGIN & END give the tree its shape
+ *      so are never skipped.
  *
  * RETURNS
- *      vf_encoding_t.
+ *      TRUE <=> skip the value, FALSE else.
  *---------------------------------------------------------------------------*/
 
-vf_encoding_t deduce_encoding(
-    VSTRARRAY_T *p_propname     /* Property name */
+bool_t skip_property(
+    VPARSE_T *p_parse           /* Current parse state info */
     )
 {
-    vf_encoding_t ret = VF_ENC_7BIT;
+    VSTRARRAY_T *p_name = &(p_parse->prop.name);
+    const char *p_string = p_name->n_strings ? p_name->pp_strings[0] : NULL;
+    bool_t listed = FALSE;
+    uint32_t i;
 
-    if (string_array_contains_string(p_propname, NULL, NULL, (uint32_t)-1, VFP_QUOTEDPRINTABLE, FALSE))
+    if (!p_string ||
+        string_array_contains_string(p_name, NULL, NULL, 0, VFP_BEGIN, TRUE) ||
+        string_array_contains_string(p_name, NULL, NULL, 0, VFP_END, TRUE))
     {
-        ret = VF_ENC_QUOTEDPRINTABLE;
+        return FALSE;
     }
-    else
-    if (string_array_contains_string(p_propname, NULL, NULL, (uint32_t)-1, VFP_BASE64, FALSE))
+
+    if ((VF_ENC_BASE64 == p_parse->prop.value.encoding) && (p_parse->flags & VFPF_SKIPBINARY))
     {
-        ret = VF_ENC_BASE64;
+        return TRUE;
     }
-    else
-    if (string_array_contains_string(p_propname, NULL, NULL, (uint32_t)-1, VFP_8BIT, FALSE))
+
+    if (!p_parse->pp_filter)
+    {
+        return FALSE;
+    }
+
+    for (i = 0;!listed && (i < p_parse->n_filter);i++)
     {
-        ret = VF_ENC_8BIT;
+        const char *p_tag = p_parse->pp_filter[i];
+
+        listed = (bool_t)ATOM_MATCH(p_string, p_tag, IS_ATOM(p_tag) ? p_tag : NULL);
     }
 
-    return ret;
+    return (bool_t)(listed != p_parse->filter_allow);
 }
 
 /*----------------------------------------------------------------------------*
  * NAME
- *      is_hex_digit()
+ *      free_filter()
  * 
  * DESCRIPTION
- *      
+ *      Release the list of names set by vf_parse_set_filter().
  *
  * RETURNS
- *      TRUE <=> valid HEX digit read.
+ *      (none)
  *---------------------------------------------------------------------------*/
 
-bool_t is_hex_digit(
-    uint8_t *p_nibble,  /* Output nibble value */
-    char c              /* Character read from file */
+void free_filter(
+    VPARSE_T *p_parse           /* Current parse state info */
     )
 {
-    bool_t ret = TRUE;
+    uint32_t i;
 
-    if (('A' <= c) && (c <= 'F'))
+    for (i = 0;i < p_parse->n_filter;i++)
     {
-        *p_nibble = (uint8_t)(c - 'A' + 10);
+        if (!IS_ATOM(p_parse->pp_filter[i]))
+        {
+            vf_free((char *)p_parse->pp_filter[i]);
+        }
     }
-    else
-    if (('a' <= c) && (c <= 'f'))
+
+    if (p_parse->pp_filter)
     {
-        *p_nibble = (uint8_t)(c - 'a' + 10);
+        vf_free((void *)p_parse->pp_filter);
     }
-    else
-    if (('0' <= c) && (c <= '9'))
+
+    p_parse->pp_filter = NULL;
+    p_parse->n_filter = 0;
+}
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      resync_after_error()
+ * 
+ * DESCRIPTION
+ *      Recover from the syntax error at p_parse->p_error (VFPF_RECOVER).  The
+ *      property being read is dropped & we skip to the start of the next
+ *      line which isn't part of it, everything parsed so far being kept.
+ *      An error found replaying a BASE64 line is taken to be at c.
+ *
+ * RETURNS
+ *      Index in p_chars of the last character dealt with.
+ *---------------------------------------------------------------------------*/
+
+uint32_t resync_after_error(
+    VPARSE_T *p_parse,          /* Current parse state info */
+    char c,                     /* Character being parsed */
+    const char *p_chars,        /* Characters being parsed */
+    uint32_t numchars,          /* Number of characters */
+    uint32_t i                  /* Index of c */
+    )
+{
+    const char *p_error = p_parse->p_error;
+    uint32_t at = i;
+
+    /*
+     * c stands in for p_chars[i] which may have been overwritten by the
+     * terminator of a view.
+     */
+    if ((p_error >= p_chars) && (p_error < p_chars + numchars) && (p_error != p_chars + i))
+    {
+        at = (uint32_t)(p_error - p_chars);
+        c = *p_error;
+    }
+
+    delete_prop_contents((VF_PROP_T *)&p_parse->prop, TRUE);
+
+    p_parse->n_line = 0;
+    p_parse->skip = FALSE;
+    p_parse->p_view_seal = NULL;
+    p_parse->p_error = NULL;
+
+    if (ISCRORNL(c))
     {
-        *p_nibble = (uint8_t)(c - '0');
+        p_parse->state = _VF_STATE_RESYNCNL;
     }
     else
     {
-        ret = FALSE;
+        p_parse->qpchar = c;
+        p_parse->state = _VF_STATE_RESYNC;
     }
 
-    return ret;
+    return at;
 }
 
 /*----------------------------------------------------------------------------*
  * NAME
- *      base64_to_char()
+ *      append_chars()
  * 
  * DESCRIPTION
- *      Convert base 64 char to byte.
+ *      Append a run of characters to the current string of a name or value.
+ *      If the characters come from the vf_parse_buffer() buffer, they're
+ *      added as a view and we note where the terminator has to go.
  *
  * RETURNS
- *      Number corresponding to char.
+ *      TRUE <=> allocation OK, FALSE else.
  *---------------------------------------------------------------------------*/
 
-uint8_t base64_to_char(char c)
+bool_t append_chars(
+    VPARSE_T *p_parse,          /* Current parse state info */
+    VSTRARRAY_T *p_strarray,    /* Array we're appending to */
+    char *p_chars,              /* Characters to append */
+    uint32_t numchars           /* Number of characters */
+    )
 {
-    if (('A' <= c) && (c <= 'Z'))
-        return (uint8_t)(c - 'A');
+    bool_t ok;
+
+    if (p_parse->p_view_start && (p_parse->p_view_start <= p_chars) && (p_chars + numchars <= p_parse->p_view_end))
+    {
+        ok = append_view_to_curr_string(p_strarray, p_chars, numchars);
+
+        p_parse->p_view_seal = p_chars + numchars;
+        p_parse->p_view_strarray = p_strarray;
+    }
+    else
+    {
+        ok = append_to_curr_string(p_strarray, NULL, p_chars, numchars);
+    }
 
-    if (('a' <= c) && (c <= 'z'))
-        return (uint8_t)(c - 'a' + 26);
+    return ok;
+}
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      span_length()
+ * 
+ * DESCRIPTION
+ *      Count the characters at p_chars up to (but not including) the first
+ *      character belonging to one of the indicated classes.  The inner loop
+ *      tests four characters at a time against the class table so that long
+ *      runs of ordinary text are skipped with few branches.
+ *
+ * RETURNS
+ *      Number of characters in the span.
+ *---------------------------------------------------------------------------*/
 
-    if (('0' <= c) && (c <= '9'))
-        return (uint8_t)(c - '0' + 52);
+uint32_t span_length(
+    const char *p_chars,        /* Characters to scan */
+    uint32_t numchars,          /* Number of characters available */
+    uint8_t delims              /* Character classes ending the span */
+    )
+{
+    const uint8_t *p = (const uint8_t *)p_chars;
+    uint32_t n = 0;
 
-    if ('+' == c)
-        return (uint8_t)(62);
+    while ((n + 4 <= numchars) &&
+        !((char_class[p[n]] | char_class[p[n + 1]] | char_class[p[n + 2]] | char_class[p[n + 3]]) & delims))
+    {
+        n += 4;
+    }
 
-    if ('/' == c)
-        return (uint8_t)(63);
+    while ((n < numchars) && !(char_class[p[n]] & delims))
+    {
+        n++;
+    }
 
-    return 0x00;
+    return n;
 }
 
 /*============================================================================*
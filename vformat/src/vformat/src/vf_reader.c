@@ -95,6 +95,9 @@ static const char vf_reader_c_vss_id[] = "$Header: /cvsroot/vformat/src/vformat/
 
 #include <common/types.h>
 
+/* vf_config.h says which of the optional headers below are available */
+#include "vf_config.h"
+
 #include <stdio.h>
 #include <sys/stat.h>
 
@@ -106,6 +109,10 @@ static const char vf_reader_c_vss_id[] = "$Header: /cvsroot/vformat/src/vformat/
 #include <io.h>
 #endif
 
+#if defined(HAS_SYS_MMAN_H)
+#include <sys/mman.h>
+#endif
+
 
 /*============================================================================*
  Interface Header Files
@@ -117,7 +124,6 @@ static const char vf_reader_c_vss_id[] = "$Header: /cvsroot/vformat/src/vformat/
  Local Header File
  *============================================================================*/
 
-#include "vf_config.h"
 #include "vf_internals.h"
 #include "vf_malloc.h"
 
@@ -135,6 +141,14 @@ static const char vf_reader_c_vss_id[] = "$Header: /cvsroot/vformat/src/vformat/
  */
 #define PARSEBUFSIZE    (1024)
 
+/*
+ * When the file can be mapped, it's handed to the parser in spans of this
+ * size (the whole file in practice).
+ */
+#if !defined(MAPSPANSIZE)
+#define MAPSPANSIZE     (0x40000000UL)
+#endif
+
 /*============================================================================*
  Private Data Types
  *============================================================================*/
@@ -143,7 +157,24 @@ static const char vf_reader_c_vss_id[] = "$Header: /cvsroot/vformat/src/vformat/
 /*============================================================================*
  Private Function Prototypes
  *============================================================================*/
-/* None */
+
+static bool_t read_file(
+    const char *p_name,         /* Name of file to read */
+    VF_PARSER_T *p_parser       /* Parser to feed */
+    );
+
+static bool_t parse_file(
+    FILE *fp,                   /* File to read */
+    VF_PARSER_T *p_parser       /* Parser to feed */
+    );
+
+#if defined(HAS_SYS_MMAN_H)
+static bool_t parse_mapped_file(
+    int fd,                     /* File to read */
+    VF_PARSER_T *p_parser,      /* Parser to feed */
+    bool_t *p_ok                /* Result of the parse */
+    );
+#endif
 
 /*============================================================================*
  Private Data
@@ -171,48 +202,41 @@ bool_t vf_read_file(
     )
 {
     bool_t ret = FALSE;
+    VF_PARSER_T *p_parser;
 
-    if (pp_object)
+    if (pp_object && vf_parse_init(&p_parser, pp_object))
     {
-        FILE *fp;
-
-        fp = fopen(p_name, "rb");
-
-        if (fp)
-        {
-            char buffer[PARSEBUFSIZE];
-            int charsread;
-            VF_PARSER_T *p_parser;
+        ret = read_file(p_name, p_parser);
+    }
 
-            if (vf_parse_init(&p_parser, pp_object))
-            {
-                do
-                {
-                    charsread = read(fileno(fp), buffer, sizeof(buffer));
+    return ret;
+}
 
-                    if (0 < charsread)
-                    {
-                        ret = vf_parse_text(p_parser, buffer, (uint32_t)charsread);
-                    }
-                }
-                while (ret && (0 < charsread))
-                    ;
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      vf_read_file_to_callback()
+ * 
+ * DESCRIPTION
+ *      Reads indicated VOBJECT_T file, passing each top level object to a
+ *      callback as it is completed.
+ *
+ * RETURNS
+ *      TRUE <=> read OK, FALSE else.
+ *----------------------------------------------------------------------------*/
 
-                if (!vf_parse_end(p_parser))
-                {
-                    ret = FALSE;
-                }
-            }
+bool_t vf_read_file_to_callback(
+    const char *p_name,             /* Name of file to read */
+    vf_parse_callback_t p_callback, /* Called with each top level object */
+    uint32_t n_context,             /* Callback context */
+    void *p_context                 /* A bit more callback context */
+    )
+{
+    bool_t ret = FALSE;
+    VF_PARSER_T *p_parser;
 
-            if (0 == fclose(fp))
-            {
-                /* OK */
-            }
-            else
-            {
-                ret = FALSE;
-            }
-        }
+    if (vf_parse_init_callback(&p_parser, p_callback, n_context, p_context))
+    {
+        ret = read_file(p_name, p_parser);
     }
 
     return ret;
@@ -278,7 +302,153 @@ bool_t vf_set_property_from_file(
 /*============================================================================*
  Private Function Implementations
  *============================================================================*/
-/* None */
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      read_file()
+ * 
+ * DESCRIPTION
+ *      Open the named file and push its contents through the parser, which
+ *      is ended whether or not the file could be read.
+ *
+ * RETURNS
+ *      TRUE <=> read & parsed OK, FALSE else.
+ *---------------------------------------------------------------------------*/
+
+bool_t read_file(
+    const char *p_name,         /* Name of file to read */
+    VF_PARSER_T *p_parser       /* Parser to feed */
+    )
+{
+    bool_t ret = FALSE;
+    FILE *fp;
+
+    fp = fopen(p_name, "rb");
+
+    if (fp)
+    {
+        ret = parse_file(fp, p_parser);
+
+        if (0 == fclose(fp))
+        {
+            /* OK */
+        }
+        else
+        {
+            ret = FALSE;
+        }
+    }
+
+    if (!vf_parse_end(p_parser))
+    {
+        ret = FALSE;
+    }
+
+    return ret;
+}
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      parse_file()
+ * 
+ * DESCRIPTION
+ *      Push the contents of a file through the parser.  Regular files are
+ *      mapped into memory where the platform allows, anything else (pipes,
+ *      devices or a failed mapping) is read PARSEBUFSIZE bytes at a time.
+ *
+ * RETURNS
+ *      TRUE <=> read & parsed OK, FALSE else.
+ *---------------------------------------------------------------------------*/
+
+bool_t parse_file(
+    FILE *fp,                   /* File to read */
+    VF_PARSER_T *p_parser       /* Parser to feed */
+    )
+{
+    bool_t ret = FALSE;
+    char buffer[PARSEBUFSIZE];
+    int charsread;
+
+#if defined(HAS_SYS_MMAN_H)
+    if (parse_mapped_file(fileno(fp), p_parser, &ret))
+    {
+        return ret;
+    }
+#endif
+
+    do
+    {
+        charsread = read(fileno(fp), buffer, sizeof(buffer));
+
+        if (0 < charsread)
+        {
+            ret = vf_parse_text(p_parser, buffer, (uint32_t)charsread);
+        }
+    }
+    while (ret && (0 < charsread))
+        ;
+
+    return ret;
+}
+
+#if defined(HAS_SYS_MMAN_H)
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      parse_mapped_file()
+ * 
+ * DESCRIPTION
+ *      Map a regular file and pass the whole mapping to the parser, which
+ *      avoids a read() call per PARSEBUFSIZE bytes.  The mapping is private
+ *      and read only, the parser copies anything it keeps.
+ *
+ * RETURNS
+ *      TRUE <=> file was mapped, in which case *p_ok holds the result of the
+ *      parse.  FALSE => nothing consumed, caller should read the file.
+ *---------------------------------------------------------------------------*/
+
+bool_t parse_mapped_file(
+    int fd,                     /* File to read */
+    VF_PARSER_T *p_parser,      /* Parser to feed */
+    bool_t *p_ok                /* Result of the parse */
+    )
+{
+    bool_t mapped = FALSE;
+    struct stat buf;
+
+    if ((0 == fstat(fd, &buf)) && S_ISREG(buf.st_mode) && (0 < buf.st_size) &&
+        ((off_t)(size_t)buf.st_size == buf.st_size))
+    {
+        size_t length = (size_t)buf.st_size;
+        char *p_map = (char *)mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (MAP_FAILED != p_map)
+        {
+            size_t posn;
+            bool_t ok = TRUE;
+
+#if defined(MADV_SEQUENTIAL)
+            (void)madvise(p_map, length, MADV_SEQUENTIAL);
+#endif
+
+            for (posn = 0;ok && (posn < length);)
+            {
+                uint32_t span = (uint32_t)(((length - posn) < MAPSPANSIZE) ? (length - posn) : MAPSPANSIZE);
+
+                ok = vf_parse_text(p_parser, p_map + posn, span);
+
+                posn += span;
+            }
+
+            (void)munmap(p_map, length);
+
+            *p_ok = ok;
+            mapped = TRUE;
+        }
+    }
+
+    return mapped;
+}
+#endif
 
 /*============================================================================*
  End Of File
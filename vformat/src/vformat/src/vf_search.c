@@ -87,6 +87,9 @@ static const char vf_search_c_vss_id[] = "$Header: /cvsroot/vformat/src/vformat/
 #include "vf_internals.h"
 #include "vf_strings.h"
 #include "vf_string_arrays.h"
+#include "vf_arena.h"
+#include "vf_atoms.h"
+#include "vf_modified.h"
 
 /*===========================================================================*
  Public Data
@@ -196,6 +199,8 @@ bool_t vf_get_property_ex(
 {
     bool_t ret = FALSE;
     char **pp_tags = NULL;
+    const char *tag_atoms[MAXNUMTAGS];
+    uint32_t tag_bits[MAXNUMTAGS];
 
     if (!p_name || !p_object)
         return ret;
@@ -244,6 +249,17 @@ bool_t vf_get_property_ex(
             }
         }
 
+        /*
+         * Look the tags up once, the comparisons below are then against
+         * addresses for the names the parser found in the atom table.  A
+         * well known qualifier is just a test of the property's VPQ_ bits.
+         */
+        for (i = 0;i < MAXNUMTAGS;i++)
+        {
+            tag_atoms[i] = pp_tags[i] ? atom_find(pp_tags[i], p_strlen(pp_tags[i]), FALSE) : NULL;
+            tag_bits[i] = tag_atoms[i] ? (atom_qualifier(tag_atoms[i]) & VPQ_TYPES) : 0;
+        }
+
         if (ops & VFGP_FIND)
         {
             /*
@@ -268,7 +284,7 @@ bool_t vf_get_property_ex(
 
                     const char *p_name = p_props->name.pp_strings[0];
 
-                    if (!p_name || (0 != p_stricmp(pp_tags[0], p_name)))
+                    if (!p_name || !ATOM_MATCH(p_name, pp_tags[0], tag_atoms[0]))
                     {
                         found = FALSE;
                     }
@@ -281,8 +297,11 @@ bool_t vf_get_property_ex(
                  */
                 for (i = idx;found && (i < MAXNUMTAGS) && pp_tags[i];i++)
                 {
+                    if (tag_bits[i])
+                        found &= (bool_t)(0 != (p_props->qualifiers & tag_bits[i]));
+                    else
                     if (0 != p_strcmp(VFP_ANY, pp_tags[i]))
-                        found &= string_array_contains_string(&p_props->name, NULL, NULL, (uint32_t)-1, pp_tags[i], TRUE);
+                        found &= string_array_contains_tag(&p_props->name, pp_tags[i], tag_atoms[i]);
                 }
                 if (p_group && found)
                 {
@@ -352,6 +371,8 @@ bool_t vf_get_property_ex(
                 {
                     /* All OK */
 
+                    classify_prop_name(p_new);
+
                     p_new->value.encoding = VF_ENC_7BIT;
                 }
                 else
@@ -373,6 +394,15 @@ bool_t vf_get_property_ex(
                 p_new->p_next = *pp_lastprop;              
                 *pp_lastprop = p_new;
 
+                if (!p_new->p_next)
+                {
+                    p_obj->p_last_prop = p_new;
+                }
+
+                arena_note_heap_use(p_new);
+
+                mark_property_modified(p_new, TRUE);
+
                 ret = TRUE;
             }
         }
@@ -69,6 +69,7 @@ static const char vf_string_arrays_c_vss_id[] = "$Header: /cvsroot/vformat/src/v
 #include "vf_internals.h"
 #include "vf_strings.h"
 #include "vf_string_arrays.h"
+#include "vf_atoms.h"
 
 /*============================================================================*
  Public Data
@@ -78,7 +79,14 @@ static const char vf_string_arrays_c_vss_id[] = "$Header: /cvsroot/vformat/src/v
 /*============================================================================*
  Private Defines
  *============================================================================*/
-/* None */
+
+/*
+ * Minimum allocation made when growing string array slots.  Slots and buffers
+ * double in size each time they are grown.
+ */
+#if !defined(VFMINSLOTALLOC)
+#define VFMINSLOTALLOC              (4)
+#endif
 
 /*============================================================================*
  Private Data Types
@@ -125,6 +133,7 @@ bool_t string_array_contains_string(
     bool_t ret = FALSE;
     uint32_t i;
     uint32_t s, e;
+    const char *p_atom = exact ? atom_find(p_string, p_strlen(p_string), FALSE) : NULL;
 
     if (index == (-1))
     {
@@ -143,7 +152,7 @@ bool_t string_array_contains_string(
         {
             if (exact)
             {
-                if (0 == p_stricmp(p_strarray->pp_strings[i], p_string))
+                if (ATOM_MATCH(p_strarray->pp_strings[i], p_string, p_atom))
                     ret = TRUE;
             }
             else
@@ -166,6 +175,39 @@ bool_t string_array_contains_string(
     return ret;
 }
 
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      string_array_contains_tag()
+ * 
+ * DESCRIPTION
+ *      Case insensitive check for an entry equal to a tag, where the caller
+ *      has already looked the tag up with atom_find().
+ *
+ * RETURNS
+ *      TRUE <=> includes indicated value, FALSE else.
+ *----------------------------------------------------------------------------*/
+
+bool_t string_array_contains_tag(
+    VSTRARRAY_T *p_strarray,        /* String array */
+    const char *p_tag,              /* The string we're looking for */
+    const char *p_tag_atom          /* Its atom, NULL if none */
+    )
+{
+    uint32_t i;
+
+    for (i = 0;i < p_strarray->n_strings;i++)
+    {
+        const char *p_string = p_strarray->pp_strings[i];
+
+        if (p_string && ATOM_MATCH(p_string, p_tag, p_tag_atom))
+        {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
 /*----------------------------------------------------------------------------*
  * NAME
  *      add_string_to_array()
@@ -182,12 +224,18 @@ bool_t add_string_to_array(
     const char *p_string            /* String to add */
     )
 {
-    char **pp_new;
     bool_t ret = FALSE;
 
-    pp_new = (char **)vf_realloc(p_strarray->pp_strings, sizeof(char *) * (1 + p_strarray->n_strings));
+    /*
+     * The string we're moving on from won't be appended to again so release
+     * any slack that was allocated while it was being built up.
+     */
+    if (p_strarray->n_strings && p_strarray->n_curalloc)
+    {
+        trim_buffer(&(p_strarray->pp_strings[p_strarray->n_strings - 1]), 1 + p_strarray->n_curlen, &(p_strarray->n_curalloc));
+    }
 
-    if (pp_new)
+    if (grow_string_array(p_strarray, 1 + p_strarray->n_strings))
     {
         if (p_string)
         {
@@ -202,18 +250,18 @@ bool_t add_string_to_array(
             {
                 p_strcpy(p_strcopy, p_string);
 
-                pp_new[p_strarray->n_strings] = p_strcopy;
+                p_strarray->pp_strings[p_strarray->n_strings] = p_strcopy;
+                p_strarray->n_curlen = l;
+                p_strarray->n_curalloc = 1 + l;
 
                 ret = TRUE;
             }
-            else
-            {
-                vf_free(pp_new);
-            }
         }
         else
         {
-            pp_new[p_strarray->n_strings] = NULL;
+            p_strarray->pp_strings[p_strarray->n_strings] = NULL;
+            p_strarray->n_curlen = 0;
+            p_strarray->n_curalloc = 0;
 
             ret = TRUE;
         }
@@ -221,7 +269,6 @@ bool_t add_string_to_array(
         if (ret)
         {
             p_strarray->n_strings += 1;
-            p_strarray->pp_strings = pp_new;
         }
     }
 
@@ -249,17 +296,27 @@ void free_string_array_contents(
 
         for (i = 0;i < p_strarray->n_strings;i++)
         {
-            if (p_strarray->pp_strings[i])
+            if (p_strarray->pp_strings[i] && !STRING_IS_VIEW(p_strarray, i))
             {
                 vf_free(p_strarray->pp_strings[i]);
-                p_strarray->pp_strings[i] = NULL;
             }
+
+            p_strarray->pp_strings[i] = NULL;
+        }
+
+        if (!p_strarray->shared_slots)
+        {
+            vf_free(p_strarray->pp_strings);
         }
 
-        vf_free(p_strarray->pp_strings);
         p_strarray->pp_strings = NULL;
+        p_strarray->shared_slots = FALSE;
 
         p_strarray->n_strings = 0;
+        p_strarray->n_alloc = 0;
+        p_strarray->n_curlen = 0;
+        p_strarray->n_curalloc = 0;
+        p_strarray->views = 0;
     }
 }
 
@@ -283,14 +340,40 @@ bool_t append_to_curr_string(
 {
     bool_t ret = TRUE;
 
-    if (p_strarray && !p_strarray->pp_strings)
+    if (p_strarray && !p_strarray->n_strings)
     {
         ret = add_string_to_array(p_strarray, "");
     }
 
     if (ret)
     {
-        ret = append_to_pointer(&(p_strarray->pp_strings[p_strarray->n_strings - 1]), p_length, p_chars, numchars);
+        ret = own_string_array_entry(p_strarray, p_strarray->n_strings - 1);
+    }
+
+    if (ret)
+    {
+        char **pp_string = &(p_strarray->pp_strings[p_strarray->n_strings - 1]);
+
+        if (p_length)
+        {
+            ret = append_to_pointer(pp_string, p_length, p_chars, numchars);
+
+            p_strarray->n_curalloc = 0;
+        }
+        else
+        {
+            if (!p_strarray->n_curalloc)
+            {
+                /*
+                 * Entry was set up by someone else, all we know is that it
+                 * was allocated to fit.
+                 */
+                p_strarray->n_curlen = *pp_string ? p_strlen(*pp_string) : 0;
+                p_strarray->n_curalloc = *pp_string ? 1 + p_strarray->n_curlen : 0;
+            }
+
+            ret = append_to_buffer(pp_string, &(p_strarray->n_curlen), &(p_strarray->n_curalloc), p_chars, numchars, TRUE);
+        }
     }
 
     return ret;
@@ -380,10 +463,21 @@ bool_t set_string_array_entry(
 
     if (n_string < p_strarray->n_strings)
     {
-        if (p_strarray->pp_strings[n_string])
+        if (n_string == p_strarray->n_strings - 1)
+        {
+            p_strarray->n_curalloc = 0;
+        }
+
+        if (p_strarray->pp_strings[n_string] && !STRING_IS_VIEW(p_strarray, n_string))
         {
             vf_free(p_strarray->pp_strings[n_string]);
-            p_strarray->pp_strings[n_string] = NULL;
+        }
+
+        p_strarray->pp_strings[n_string] = NULL;
+
+        if (n_string < VSTRARRAY_MAXVIEWS)
+        {
+            p_strarray->views &= ~((uint32_t)1 << n_string);
         }
 
         if (p_string)
@@ -410,6 +504,389 @@ bool_t set_string_array_entry(
     return ret;
 }
 
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      append_view_to_curr_string()
+ * 
+ * DESCRIPTION
+ *      As append_to_curr_string(), but if the current string is empty (or a
+ *      view ending just where p_chars starts) make it a view onto p_chars
+ *      rather than copying them.  The caller must NULL terminate the view
+ *      once the character following it has been read, until then n_curlen
+ *      holds its length.  Anything that can't be a view is copied.
+ *
+ * RETURNS
+ *      TRUE <=> allocation OK, FALSE else.
+ *----------------------------------------------------------------------------*/
+
+bool_t append_view_to_curr_string(
+    VSTRARRAY_T *p_strarray,        /* String array */
+    char *p_chars,                  /* Characters to append */
+    uint32_t numchars               /* Number of characters */
+    )
+{
+    bool_t ret = TRUE;
+    uint32_t n;
+
+    if (!p_strarray->n_strings)
+    {
+        ret = add_string_to_array(p_strarray, NULL);
+    }
+
+    n = p_strarray->n_strings - 1;
+
+    if (!ret || (VSTRARRAY_MAXVIEWS <= n))
+    {
+        /* Failed, or no room to record a view */
+    }
+    else
+    if (STRING_IS_VIEW(p_strarray, n))
+    {
+        if (p_strarray->pp_strings[n] + p_strarray->n_curlen == p_chars)
+        {
+            p_strarray->n_curlen += numchars;
+
+            return TRUE;
+        }
+    }
+    else
+    if (!p_strarray->pp_strings[n] || ('\0' == *(p_strarray->pp_strings[n])))
+    {
+        if (p_strarray->pp_strings[n])
+        {
+            vf_free(p_strarray->pp_strings[n]);
+        }
+
+        p_strarray->pp_strings[n] = p_chars;
+        p_strarray->views |= ((uint32_t)1 << n);
+        p_strarray->n_curlen = numchars;
+        p_strarray->n_curalloc = 0;
+
+        return TRUE;
+    }
+
+    if (ret)
+    {
+        ret = append_to_curr_string(p_strarray, NULL, p_chars, numchars);
+    }
+
+    return ret;
+}
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      own_string_array_entry()
+ * 
+ * DESCRIPTION
+ *      If the indicated entry is a view, replace it with an allocated copy.
+ *      The last entry may be a view that isn't yet terminated so we use the
+ *      recorded length for it.
+ *
+ * RETURNS
+ *      TRUE <=> allocation OK, FALSE else.
+ *----------------------------------------------------------------------------*/
+
+bool_t own_string_array_entry(
+    VSTRARRAY_T *p_strarray,        /* String array */
+    uint32_t n_string               /* Entry to copy */
+    )
+{
+    bool_t ret = TRUE;
+
+    if ((n_string < p_strarray->n_strings) && STRING_IS_VIEW(p_strarray, n_string))
+    {
+        bool_t last = (bool_t)(n_string == p_strarray->n_strings - 1);
+        uint32_t len = last ? p_strarray->n_curlen : (uint32_t)p_strlen(p_strarray->pp_strings[n_string]);
+        char *p_copy = (char *)vf_malloc(1 + len);
+
+        if (p_copy)
+        {
+            p_memcpy(p_copy, p_strarray->pp_strings[n_string], len);
+            p_copy[len] = '\0';
+
+            p_strarray->pp_strings[n_string] = p_copy;
+            p_strarray->views &= ~((uint32_t)1 << n_string);
+
+            if (last)
+            {
+                p_strarray->n_curlen = len;
+                p_strarray->n_curalloc = 1 + len;
+            }
+        }
+        else
+        {
+            ret = FALSE;
+        }
+    }
+
+    return ret;
+}
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      take_string_array_entry()
+ * 
+ * DESCRIPTION
+ *      Remove the indicated entry from the array, passing ownership of the
+ *      (allocated) string to the caller.  The slot is left NULL.
+ *
+ * RETURNS
+ *      The string, NULL if not present.
+ *----------------------------------------------------------------------------*/
+
+char *take_string_array_entry(
+    VSTRARRAY_T *p_strarray,        /* String array */
+    uint32_t n_string               /* Entry to remove */
+    )
+{
+    char *p_ret = NULL;
+
+    if ((n_string < p_strarray->n_strings) && own_string_array_entry(p_strarray, n_string))
+    {
+        p_ret = p_strarray->pp_strings[n_string];
+        p_strarray->pp_strings[n_string] = NULL;
+
+        if (n_string == p_strarray->n_strings - 1)
+        {
+            p_strarray->n_curalloc = 0;
+        }
+    }
+
+    return p_ret;
+}
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      append_to_buffer()
+ * 
+ * DESCRIPTION
+ *      Append characters to a buffer whose allocated size is tracked as well
+ *      as its length.  The buffer grows geometrically so building up a value
+ *      a few characters at a time costs amortised O(1) per character.  If zt
+ *      is set, the allocation includes room for (and maintains) a terminating
+ *      NULL after *p_length bytes.
+ *
+ * RETURNS
+ *      TRUE <=> allocation OK, FALSE else.
+ *----------------------------------------------------------------------------*/
+
+bool_t append_to_buffer(
+    char **pp_buffer,           /* Buffer we're appending to */
+    uint32_t *p_length,         /* Bytes used */
+    uint32_t *p_alloc,          /* Bytes allocated */
+    const char *p_chars,        /* Chars we're appending */
+    uint32_t numchars,          /* Number of chars we're appending */
+    bool_t zt                   /* Maintain a terminating NULL? */
+    )
+{
+    bool_t ok = reserve_buffer(pp_buffer, *p_length, p_alloc, numchars + (zt ? 1 : 0));
+
+    if (ok)
+    {
+        p_memcpy(*pp_buffer + *p_length, p_chars, numchars);
+
+        *p_length += numchars;
+
+        if (zt)
+        {
+            (*pp_buffer)[*p_length] = '\0';
+        }
+    }
+
+    return ok;
+}
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      reserve_buffer()
+ * 
+ * DESCRIPTION
+ *      Make sure a buffer built up with append_to_buffer() has room for
+ *      another numchars bytes after the length bytes in use.
+ *
+ * RETURNS
+ *      TRUE <=> allocation OK, FALSE else.
+ *----------------------------------------------------------------------------*/
+
+bool_t reserve_buffer(
+    char **pp_buffer,           /* Buffer we're growing */
+    uint32_t length,            /* Bytes used */
+    uint32_t *p_alloc,          /* Bytes allocated */
+    uint32_t numchars           /* Bytes we're about to add */
+    )
+{
+    bool_t ok = TRUE;
+    uint32_t needed = length + numchars;
+
+    if (!*pp_buffer)
+    {
+        *p_alloc = 0;
+    }
+
+    if (*p_alloc < needed)
+    {
+        uint32_t newalloc = 2 * *p_alloc;
+        char *p_new;
+
+        if ((newalloc < needed) || (length == 0))
+        {
+            /*
+             * First append to an empty buffer is sized exactly, most values
+             * arrive as a single run & need no further growth or trimming.
+             */
+            newalloc = needed;
+        }
+
+        p_new = (char *)vf_realloc(*pp_buffer, newalloc);
+
+        if (p_new)
+        {
+            *pp_buffer = p_new;
+            *p_alloc = newalloc;
+        }
+        else
+        {
+            ok = FALSE;
+        }
+    }
+
+    return ok;
+}
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      trim_buffer()
+ * 
+ * DESCRIPTION
+ *      Release any slack at the end of a buffer built up with
+ *      append_to_buffer().
+ *
+ * RETURNS
+ *      (none)
+ *----------------------------------------------------------------------------*/
+
+void trim_buffer(
+    char **pp_buffer,           /* Buffer to trim */
+    uint32_t length,            /* Bytes to keep */
+    uint32_t *p_alloc           /* Bytes allocated */
+    )
+{
+    if (*pp_buffer && length && (length < *p_alloc))
+    {
+        char *p_new = (char *)vf_realloc(*pp_buffer, length);
+
+        if (p_new)
+        {
+            *pp_buffer = p_new;
+            *p_alloc = length;
+        }
+    }
+}
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      trim_string_array()
+ * 
+ * DESCRIPTION
+ *      Release slack in the slot array and in the current (last) string of
+ *      a string array, once we've finished adding to it.
+ *
+ * RETURNS
+ *      (none)
+ *----------------------------------------------------------------------------*/
+
+void trim_string_array(
+    VSTRARRAY_T *p_strarray         /* String array */
+    )
+{
+    if (p_strarray->n_strings && (p_strarray->n_strings < p_strarray->n_alloc) && !p_strarray->shared_slots)
+    {
+        char **pp_new = (char **)vf_realloc(p_strarray->pp_strings, sizeof(char *) * p_strarray->n_strings);
+
+        if (pp_new)
+        {
+            p_strarray->pp_strings = pp_new;
+            p_strarray->n_alloc = p_strarray->n_strings;
+        }
+    }
+
+    if (p_strarray->n_curalloc)
+    {
+        trim_buffer(&(p_strarray->pp_strings[p_strarray->n_strings - 1]), 1 + p_strarray->n_curlen, &(p_strarray->n_curalloc));
+    }
+}
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      grow_string_array()
+ * 
+ * DESCRIPTION
+ *      Make sure the string array has room for at least n_slots pointers,
+ *      doubling the allocation when it has to grow.  Slots we don't own are
+ *      copied to the heap first.
+ *
+ * RETURNS
+ *      TRUE <=> allocation OK, FALSE else.
+ *----------------------------------------------------------------------------*/
+
+bool_t grow_string_array(
+    VSTRARRAY_T *p_strarray,        /* String array */
+    uint32_t n_slots                /* Number of slots required */
+    )
+{
+    bool_t ok = TRUE;
+
+    if (!p_strarray->pp_strings)
+    {
+        p_strarray->n_alloc = 0;
+        p_strarray->shared_slots = FALSE;
+    }
+
+    if (p_strarray->n_alloc < n_slots)
+    {
+        uint32_t newalloc = 2 * p_strarray->n_alloc;
+        char **pp_new;
+
+        if (newalloc < n_slots)
+        {
+            newalloc = n_slots;
+        }
+
+        if (newalloc < VFMINSLOTALLOC)
+        {
+            newalloc = VFMINSLOTALLOC;
+        }
+
+        if (p_strarray->shared_slots)
+        {
+            pp_new = (char **)vf_malloc(sizeof(char *) * newalloc);
+
+            if (pp_new)
+            {
+                p_memcpy(pp_new, p_strarray->pp_strings, sizeof(char *) * p_strarray->n_strings);
+
+                p_strarray->shared_slots = FALSE;
+            }
+        }
+        else
+        {
+            pp_new = (char **)vf_realloc(p_strarray->pp_strings, sizeof(char *) * newalloc);
+        }
+
+        if (pp_new)
+        {
+            p_strarray->pp_strings = pp_new;
+            p_strarray->n_alloc = newalloc;
+        }
+        else
+        {
+            ok = FALSE;
+        }
+    }
+
+    return ok;
+}
+
 /*============================================================================*
  Private Function Implementations
  *============================================================================*/
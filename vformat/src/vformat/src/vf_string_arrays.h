@@ -53,7 +53,16 @@ static const char vf_string_arrays_h_vss_id[] = "$Header: /cvsroot/vformat/src/v
 /*=============================================================================*
  Public Defines
  *============================================================================*/
-/* None */
+
+/*
+ * Entries of a string array may be "views" onto memory the array doesn't own
+ * (see vf_parse_buffer() and vf_atoms.h).  Only the first VSTRARRAY_MAXVIEWS
+ * entries can be views, a bit in VSTRARRAY_T::views marks each one.
+ */
+#define VSTRARRAY_MAXVIEWS          (32)
+
+#define STRING_IS_VIEW(p_strarray, n) \
+    (((n) < VSTRARRAY_MAXVIEWS) && ((p_strarray)->views & ((uint32_t)1 << (n))))
 
 /*=============================================================================*
  Public Types
@@ -87,6 +96,24 @@ extern bool_t string_array_contains_string(
     bool_t exact                                /* Exact or partial match */
     );
 
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      string_array_contains_tag()
+ * 
+ * DESCRIPTION
+ *      Case insensitive check for an entry equal to a tag, where the caller
+ *      has already looked the tag up with atom_find().
+ *
+ * RETURNS
+ *      TRUE <=> includes indicated value, FALSE else.
+ *----------------------------------------------------------------------------*/
+
+extern bool_t string_array_contains_tag(
+    VSTRARRAY_T *p_strarray,                    /* String array */
+    const char *p_tag,                          /* The string we're looking for */
+    const char *p_tag_atom                      /* Its atom, NULL if none */
+    );
+
 /*----------------------------------------------------------------------------*
  * NAME
  *      add_string_to_array()
@@ -156,6 +183,133 @@ extern bool_t append_to_pointer(
     uint32_t numchars                           /* Number of chars we're appending */
     );
 
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      append_to_buffer()
+ * 
+ * DESCRIPTION
+ *      Append characters to a buffer whose allocated size is tracked as well
+ *      as its length, growing it geometrically.  If zt is set the buffer is
+ *      kept NULL terminated.
+ *
+ * RETURNS
+ *      TRUE <=> allocation OK, FALSE else.
+ *----------------------------------------------------------------------------*/
+
+extern bool_t append_to_buffer(
+    char **pp_buffer,                           /* Buffer we're appending to */
+    uint32_t *p_length,                         /* Bytes used */
+    uint32_t *p_alloc,                          /* Bytes allocated */
+    const char *p_chars,                        /* Chars we're appending */
+    uint32_t numchars,                          /* Number of chars we're appending */
+    bool_t zt                                   /* Maintain a terminating NULL? */
+    );
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      reserve_buffer()
+ * 
+ * DESCRIPTION
+ *      Make sure a buffer built up with append_to_buffer() has room for
+ *      another numchars bytes, so they can be written in place.
+ *
+ * RETURNS
+ *      TRUE <=> allocation OK, FALSE else.
+ *----------------------------------------------------------------------------*/
+
+extern bool_t reserve_buffer(
+    char **pp_buffer,                           /* Buffer we're growing */
+    uint32_t length,                            /* Bytes used */
+    uint32_t *p_alloc,                          /* Bytes allocated */
+    uint32_t numchars                           /* Bytes we're about to add */
+    );
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      trim_buffer()
+ * 
+ * DESCRIPTION
+ *      Release any slack at the end of a buffer built up with
+ *      append_to_buffer().
+ *
+ * RETURNS
+ *      (none)
+ *----------------------------------------------------------------------------*/
+
+extern void trim_buffer(
+    char **pp_buffer,                           /* Buffer to trim */
+    uint32_t length,                            /* Bytes to keep */
+    uint32_t *p_alloc                           /* Bytes allocated */
+    );
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      trim_string_array()
+ * 
+ * DESCRIPTION
+ *      Release slack in the slot array and in the current (last) string of
+ *      a string array.
+ *
+ * RETURNS
+ *      (none)
+ *----------------------------------------------------------------------------*/
+
+extern void trim_string_array(
+    VSTRARRAY_T *p_strarray                     /* String array */
+    );
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      append_view_to_curr_string()
+ * 
+ * DESCRIPTION
+ *      As append_to_curr_string(), but if possible make the current string a
+ *      view onto p_chars rather than a copy.  The caller is responsible for
+ *      NULL terminating the view, *p_curlen gives its length till then.
+ *
+ * RETURNS
+ *      TRUE <=> allocation OK, FALSE else.
+ *----------------------------------------------------------------------------*/
+
+extern bool_t append_view_to_curr_string(
+    VSTRARRAY_T *p_strarray,                    /* String array */
+    char *p_chars,                              /* Characters to append */
+    uint32_t numchars                           /* Number of characters */
+    );
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      own_string_array_entry()
+ * 
+ * DESCRIPTION
+ *      If the indicated entry is a view, replace it with an allocated copy.
+ *
+ * RETURNS
+ *      TRUE <=> allocation OK, FALSE else.
+ *----------------------------------------------------------------------------*/
+
+extern bool_t own_string_array_entry(
+    VSTRARRAY_T *p_strarray,                    /* String array */
+    uint32_t n_string                           /* Entry to copy */
+    );
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      take_string_array_entry()
+ * 
+ * DESCRIPTION
+ *      Remove the indicated entry from the array, passing ownership of the
+ *      (allocated) string to the caller.  The slot is left NULL.
+ *
+ * RETURNS
+ *      The string, NULL if not present.
+ *----------------------------------------------------------------------------*/
+
+extern char *take_string_array_entry(
+    VSTRARRAY_T *p_strarray,                    /* String array */
+    uint32_t n_string                           /* Entry to remove */
+    );
+
 /*----------------------------------------------------------------------------*
  * NAME
  *      set_string_array_entry()
@@ -173,6 +327,22 @@ extern bool_t set_string_array_entry(
     uint32_t n_string                           /* Insertion point */
     );
 
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      grow_string_array()
+ * 
+ * DESCRIPTION
+ *      Make sure a string array has room for at least n_slots entries.
+ *
+ * RETURNS
+ *      TRUE <=> allocation OK, FALSE else.
+ *----------------------------------------------------------------------------*/
+
+extern bool_t grow_string_array(
+    VSTRARRAY_T *p_strarray,                    /* String array */
+    uint32_t n_slots                            /* Number of slots required */
+    );
+
 /*=============================================================================*
  End of file
  *============================================================================*/
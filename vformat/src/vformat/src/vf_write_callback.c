@@ -42,6 +42,8 @@ static const char vf_write_callback_c_vss_id[] = "$Header: /cvsroot/vformat/src/
 
 #include <common/types.h>
 
+#include <string.h>
+
 /*============================================================================*
  Interface Header Files
  *============================================================================*/
@@ -72,15 +74,45 @@ static const char vf_write_callback_c_vss_id[] = "$Header: /cvsroot/vformat/src/
 #define VFWRITEBUFSIZE      (32)
 #endif
 
+/*
+ * Library allocated buffer for vf_write_to_callback_parallel(), which has
+ * no stack to save.
+ */
+#if !defined(VFPARALLELBUFSIZE)
+#define VFPARALLELBUFSIZE   (0x10000)
+#endif
+
 /*============================================================================*
  Private Data Types
  *============================================================================*/
-/* None */
+
+/*----------------------------------------------------------------------------*
+ * PURPOSE
+ *      The callback and the buffer being filled for it.
+ *----------------------------------------------------------------------------*/
+
+typedef struct
+{
+    char                *p_buffer;      /* Buffer passed to the callback */
+    uint32_t            bufsize;        /* Size of buffer */
+    uint32_t            length;         /* Characters waiting in the buffer */
+
+    vf_write_callback_t cb;             /* The callback function */
+    uint32_t            n_context;      /* Some callback context */
+    void                *p_context;     /* A bit more callback context */
+}
+VCALLBACK_T;
 
 /*============================================================================*
  Private Function Prototypes
  *============================================================================*/
-/* None */
+
+static bool_t fill_callback_buffer(
+    void *p_context,            /* The VCALLBACK_T */
+    const char *p_chars,        /* The text */
+    uint32_t numchars,          /* Number of characters */
+    bool_t stable               /* Text stays put till the write's done? */
+    );
 
 /*============================================================================*
  Private Data
@@ -126,7 +158,7 @@ bool_t vf_write_to_callback(
     if (p_object && cb)
     {
         char *p_callback_buffer;
-        uint16_t bytes_written;
+        size_t bytes_written;
         VF_WRITER_T *p_writer;
 
         if (p_buffer)
@@ -149,9 +181,9 @@ bool_t vf_write_to_callback(
             {
                 do
                 {
-                    if (vf_write_to_buf(p_writer, p_callback_buffer, bufsize, &bytes_written))
+                    if (vf_write_to_buf_ex(p_writer, p_callback_buffer, bufsize, &bytes_written))
                     {
-                        ret = cb(p_callback_buffer, bytes_written, n_context, p_context);
+                        ret = cb(p_callback_buffer, (uint32_t)bytes_written, n_context, p_context);
                     }
                 }
                 while (ret && (0 < bytes_written))
@@ -174,10 +206,131 @@ bool_t vf_write_to_callback(
     return ret;
 }
 
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      vf_write_to_callback_parallel()
+ * 
+ * DESCRIPTION
+ *      As vf_write_to_callback(), writing a list of objects on up to
+ *      n_threads threads (see vf_write_parallel()).  The callback is always
+ *      called on the calling thread, with the text in order.
+ *
+ * RETURNS
+ *      TRUE <=> written OK, FALSE else.
+ *----------------------------------------------------------------------------*/
+
+bool_t vf_write_to_callback_parallel(
+    VF_OBJECT_T *p_object,      /* The object to write */
+    char *p_buffer,             /* Buffer to use */
+    size_t bufsize,             /* Size of buffer to use */
+    vf_write_flags_t flags,     /* Flags controlling operation */
+    vf_write_callback_t cb,     /* The callback function */
+    uint32_t n_context,         /* Some callback context */
+    void *p_context,            /* A bit more callback context */
+    uint32_t n_threads          /* Most threads to use, including the caller's */
+    )
+{
+    bool_t ret = FALSE;
+
+    if (p_object && cb)
+    {
+        VCALLBACK_T callback;
+
+        callback.p_buffer = p_buffer;
+        callback.bufsize = (uint32_t)((bufsize < 0xFFFFFFFFUL) ? bufsize : 0xFFFFFFFFUL);
+        callback.length = 0;
+        callback.cb = cb;
+        callback.n_context = n_context;
+        callback.p_context = p_context;
+
+        if (!p_buffer)
+        {
+            /* library allocated buffer */
+
+            callback.bufsize = VFPARALLELBUFSIZE;
+            callback.p_buffer = vf_malloc(callback.bufsize);
+        }
+
+        if (callback.p_buffer && callback.bufsize)
+        {
+            ret = vf_write_parallel(p_object, flags, n_threads, fill_callback_buffer, &callback);
+
+            /* What's left, then no text to say that's the lot */
+
+            if (ret && callback.length)
+            {
+                ret = cb(callback.p_buffer, callback.length, n_context, p_context);
+            }
+
+            if (ret)
+            {
+                ret = cb(callback.p_buffer, 0, n_context, p_context);
+            }
+        }
+
+        if (!p_buffer && callback.p_buffer)
+        {
+            vf_free(callback.p_buffer);
+        }
+    }
+
+    return ret;
+}
+
 /*============================================================================*
  Private Function Implementations
  *============================================================================*/
-/* None */
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      fill_callback_buffer()
+ * 
+ * DESCRIPTION
+ *      Writer sink.  Copy the text into the buffer, handing it to the
+ *      callback each time it fills up.
+ *
+ * RETURNS
+ *      TRUE <=> callback(s) OK, FALSE else.
+ *----------------------------------------------------------------------------*/
+
+bool_t fill_callback_buffer(
+    void *p_context,            /* The VCALLBACK_T */
+    const char *p_chars,        /* The text */
+    uint32_t numchars,          /* Number of characters */
+    bool_t stable               /* Text stays put till the write's done? */
+    )
+{
+    VCALLBACK_T *p_callback = (VCALLBACK_T *)p_context;
+    bool_t ret = TRUE;
+
+    (void)stable;
+
+    while (ret && numchars)
+    {
+        uint32_t n = p_callback->bufsize - p_callback->length;
+
+        if (n > numchars)
+        {
+            n = numchars;
+        }
+
+        memcpy(p_callback->p_buffer + p_callback->length, p_chars, n);
+
+        p_callback->length += n;
+        p_chars += n;
+        numchars -= n;
+
+        if (p_callback->length == p_callback->bufsize)
+        {
+            ret = p_callback->cb(p_callback->p_buffer, p_callback->length,
+                p_callback->n_context, p_callback->p_context);
+
+            p_callback->length = 0;
+        }
+    }
+
+    return ret;
+}
 
 /*============================================================================*
  End Of File
@@ -25,8 +25,10 @@ DESCRIPTION
     user supplied callback function.  This is presented in vf_write_callback.c
     and is also platform independant.
 
-    Code below uses the VF_WRITER_T concept to write a vobject to a file
-    using stdio functions.
+    Code below uses the VF_WRITER_T concept to write a vobject to a file.
+    Text is gathered into large batches and written with writev() where
+    <sys/uio.h> is available (write() otherwise).  Longer strings belonging
+    to the object are referred to rather than copied.
 
     I imagine this sounds more complicated than you might expect but bear in
     mind my usual bad tempered gripe about embedded systems and the general
@@ -61,7 +63,28 @@ static const char vf_write_file_c_vss_id[] = "$Header: /cvsroot/vformat/src/vfor
 
 #include <common/types.h>
 
+/* vf_config.h says which of the optional headers below are available */
+#include "vf_config.h"
+
 #include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#if defined(HAS_UNISTD_H)
+#include <unistd.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
+
+#if defined(WIN) || defined(WIN32)
+#include <io.h>
+#endif
+
+#if defined(HAS_SYS_UIO_H)
+#include <limits.h>
+#include <sys/uio.h>
+#endif
 
 /*============================================================================*
  Interface Header Files
@@ -73,8 +96,8 @@ static const char vf_write_file_c_vss_id[] = "$Header: /cvsroot/vformat/src/vfor
  Local Header File
  *============================================================================*/
 
-#include "vf_config.h"
 #include "vf_internals.h"
+#include "vf_malloc.h"
 
 /*============================================================================*
  Public Data
@@ -86,10 +109,27 @@ static const char vf_write_file_c_vss_id[] = "$Header: /cvsroot/vformat/src/vfor
  *============================================================================*/
 
 /*
- * Increase for (slighty) better performance at the penalty of stack space.
+ * Text copied into the gather buffer before it is written.  Allocated from
+ * the heap for the duration of the write.
  */
-#if !defined(VFWRITEBUFSIZE)
-#define VFWRITEBUFSIZE          (32)
+#if !defined(VFGATHERBUFSIZE)
+#define VFGATHERBUFSIZE         (0x10000)
+#endif
+
+/*
+ * Strings belonging to the object at least this long get an iovec of their
+ * own rather than being copied, and the most iovecs passed to one writev().
+ */
+#if !defined(VFGATHERMINSPAN)
+#define VFGATHERMINSPAN         (256)
+#endif
+
+#if !defined(VFGATHERMAXSPANS)
+#if defined(IOV_MAX) && (IOV_MAX < 256)
+#define VFGATHERMAXSPANS        (IOV_MAX)
+#else
+#define VFGATHERMAXSPANS        (256)
+#endif
 #endif
  
 /*
@@ -99,20 +139,81 @@ static const char vf_write_file_c_vss_id[] = "$Header: /cvsroot/vformat/src/vfor
 #define VFFILEWRITEMODE         "wb"
 #endif
 
+/*
+ * Appended to the file name to make the temporary file VFWF_ATOMIC
+ * writes to before renaming it.  Where mkstemp() is available the X's are
+ * replaced to give a name of its own to each write.
+ */
+#if !defined(VFTEMPSUFFIX)
+#if defined(HAS_UNISTD_H)
+#define VFTEMPSUFFIX            ".XXXXXX"
+#else
+#define VFTEMPSUFFIX            ".tmp"
+#endif
+#endif
+
 /*============================================================================*
  Private Data Types
  *============================================================================*/
-/* None */
+
+/*----------------------------------------------------------------------------*
+ * PURPOSE
+ *      Text waiting to be written to a file descriptor.
+ *----------------------------------------------------------------------------*/
+
+typedef struct VGATHER_T
+{
+    int fd;                                     /* Where it's going */
+    uint32_t length;                            /* Bytes used in buffer[] */
+#if defined(HAS_SYS_UIO_H)
+    uint32_t n_spans;                           /* Entries used in spans[] */
+    struct iovec spans[VFGATHERMAXSPANS];       /* Text in order, refers to buffer[] or the object */
+#endif
+    char buffer[VFGATHERBUFSIZE];               /* Copied text */
+}
+VGATHER_T;
 
 /*============================================================================*
  Private Function Prototypes
  *============================================================================*/
 
-static bool_t write_to_stdio(
-    FILE *fp,                   /* The FILE* we're writing to */
-    char *p_buffer,             /* The buffer to fo whatever you're going to do */
-    uint32_t charcount          /* Number of characters in the buffer */
+static bool_t gather_text(
+    void *p_context,            /* The VGATHER_T */
+    const char *p_chars,        /* The text */
+    uint32_t numchars,          /* Number of characters */
+    bool_t stable               /* Text stays put till the write's done? */
+    );
+
+static bool_t flush_gather(
+    VGATHER_T *p_gather         /* What we're writing */
+    );
+
+static bool_t write_to_fd(
+    int fd,                     /* Where it's going */
+    const char *p_chars,        /* The text */
+    size_t numchars             /* Number of characters */
+    );
+
+#if defined(HAS_UNISTD_H)
+static bool_t write_file_atomic(
+    const char *p_name,         /* File to replace */
+    char *p_temp,               /* Template for the temporary file */
+    VF_OBJECT_T *p_object,      /* The object to write */
+    vf_write_flags_t flags      /* Flags controlling operation */
+    );
+
+static bool_t sync_directory(
+    const char *p_name          /* File whose directory is synced */
     );
+#endif
+
+#if defined(HAS_SYS_UIO_H)
+static bool_t add_span(
+    VGATHER_T *p_gather,        /* What we're writing */
+    const char *p_chars,        /* The text */
+    uint32_t numchars           /* Number of characters */
+    );
+#endif
 
 /*============================================================================*
  Private Data
@@ -128,7 +229,9 @@ static bool_t write_to_stdio(
  *      vf_write_file()
  * 
  * DESCRIPTION
- *      Write indicated vobject to file.
+ *      Write indicated vobject to file.  With VFWF_ATOMIC the text goes to
+ *      a temporary file which is renamed over p_name once it's complete,
+ *      see write_file_atomic().
  *
  * RETURNS
  *      TRUE <=> written OK, FALSE else.
@@ -144,35 +247,127 @@ bool_t vf_write_file(
 
     if (p_object && p_name)
     {
-        FILE *fp = fopen(p_name, VFFILEWRITEMODE);
+        const char *p_file = p_name;
+        char *p_temp = NULL;
 
-        if (fp)
+        if (flags & VFWF_ATOMIC)
         {
-            char buffer[VFWRITEBUFSIZE];
-            uint16_t bytes_written;
-            VF_WRITER_T *p_writer;
+            p_temp = (char *)vf_malloc(strlen(p_name) + sizeof(VFTEMPSUFFIX));
 
-            if (vf_write_init(&p_writer, p_object, flags))
+            if (p_temp)
             {
-                do
-                {
-                    ret = vf_write_to_buf(p_writer, buffer, sizeof(buffer), &bytes_written);
-                    ret &= write_to_stdio(fp, buffer, bytes_written);
-                }
-                while (ret && (0 < bytes_written))
-                    ;
+                strcpy(p_temp, p_name);
+                strcat(p_temp, VFTEMPSUFFIX);
+            }
 
-                /*
-                 * Have to have a tidy up function since callback may have failed and
-                 * left the writer with allocated memory - but this can't fail so "void".
-                 */
-                vf_write_end(p_writer);
+            p_file = p_temp;
+        }
+
+#if defined(HAS_UNISTD_H)
+        if (p_temp)
+        {
+            ret = write_file_atomic(p_name, p_temp, p_object, flags);
+        }
+        else
+#endif
+        if (p_file)
+        {
+            FILE *fp = fopen(p_file, VFFILEWRITEMODE);
+
+            if (fp)
+            {
+                ret = vf_write_fd(fileno(fp), p_object, flags);
 
                 if (0 != fclose(fp))
                 {
                     ret = FALSE;
                 }
+
+                if (p_temp)
+                {
+                    if (ret)
+                    {
+                        ret = (bool_t)(0 == rename(p_temp, p_name));
+                    }
+
+                    if (!ret)
+                    {
+                        (void)remove(p_temp);
+                    }
+                }
+            }
+        }
+
+        if (p_temp)
+        {
+            vf_free(p_temp);
+        }
+    }
+
+    return ret;
+}
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      vf_write_fd()
+ * 
+ * DESCRIPTION
+ *      Write indicated vobject to an open file descriptor.
+ *
+ * RETURNS
+ *      TRUE <=> written OK, FALSE else.
+ *----------------------------------------------------------------------------*/
+
+bool_t vf_write_fd(
+    int fd,                     /* Where to write */
+    VF_OBJECT_T *p_object,      /* The object to write */
+    vf_write_flags_t flags      /* Flags controlling operation */
+    )
+{
+    return vf_write_fd_parallel(fd, p_object, flags, 1);
+}
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      vf_write_fd_parallel()
+ * 
+ * DESCRIPTION
+ *      As vf_write_fd(), writing a list of objects on up to n_threads
+ *      threads (see vf_write_parallel()).
+ *
+ * RETURNS
+ *      TRUE <=> written OK, FALSE else.
+ *----------------------------------------------------------------------------*/
+
+bool_t vf_write_fd_parallel(
+    int fd,                     /* Where to write */
+    VF_OBJECT_T *p_object,      /* The object to write */
+    vf_write_flags_t flags,     /* Flags controlling operation */
+    uint32_t n_threads          /* Most threads to use, including the caller's */
+    )
+{
+    bool_t ret = FALSE;
+
+    if (p_object && (0 <= fd))
+    {
+        VGATHER_T *p_gather = (VGATHER_T *)vf_malloc(sizeof(VGATHER_T));
+
+        if (p_gather)
+        {
+            p_gather->fd = fd;
+            p_gather->length = 0;
+#if defined(HAS_SYS_UIO_H)
+            p_gather->n_spans = 0;
+#endif
+
+            ret = vf_write_parallel(p_object, flags, n_threads, gather_text, p_gather);
+
+            if (ret)
+            {
+                ret = flush_gather(p_gather);
             }
+
+            vf_free(p_gather);
         }
     }
 
@@ -185,23 +380,379 @@ bool_t vf_write_file(
 
 /*----------------------------------------------------------------------------*
  * NAME
- *      write_to_stdio()
+ *      gather_text()
+ * 
+ * DESCRIPTION
+ *      Writer sink.  Short or transient text is copied into the gather
+ *      buffer, longer stable text is referred to where it is.  The lot is
+ *      written out whenever the buffer or span list fills up.
+ *
+ * RETURNS
+ *      TRUE <=> written OK, FALSE else.
+ *----------------------------------------------------------------------------*/
+
+bool_t gather_text(
+    void *p_context,            /* The VGATHER_T */
+    const char *p_chars,        /* The text */
+    uint32_t numchars,          /* Number of characters */
+    bool_t stable               /* Text stays put till the write's done? */
+    )
+{
+    VGATHER_T *p_gather = (VGATHER_T *)p_context;
+    bool_t ret = TRUE;
+
+    (void)stable;
+
+#if defined(HAS_SYS_UIO_H)
+    if (stable && (VFGATHERMINSPAN <= numchars))
+    {
+        ret = add_span(p_gather, p_chars, numchars);
+    }
+    else
+#endif
+    if (numchars <= VFGATHERBUFSIZE)
+    {
+        if ((VFGATHERBUFSIZE - p_gather->length) < numchars)
+        {
+            ret = flush_gather(p_gather);
+        }
+#if defined(HAS_SYS_UIO_H)
+        else
+        if (VFGATHERMAXSPANS == p_gather->n_spans)
+        {
+            ret = flush_gather(p_gather);
+        }
+#endif
+
+        if (ret)
+        {
+            char *p_copy = p_gather->buffer + p_gather->length;
+
+            memcpy(p_copy, p_chars, numchars);
+
+            p_gather->length += numchars;
+
+#if defined(HAS_SYS_UIO_H)
+            ret = add_span(p_gather, p_copy, numchars);
+#endif
+        }
+    }
+    else
+    {
+        ret = flush_gather(p_gather) && write_to_fd(p_gather->fd, p_chars, numchars);
+    }
+
+    return ret;
+}
+
+#if defined(HAS_SYS_UIO_H)
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      add_span()
+ * 
+ * DESCRIPTION
+ *      Add text to the end of the span list, extending the last span if the
+ *      text follows on from it.  Empty text adds nothing, so that writev()
+ *      returning 0 always means it failed to make progress.
+ *
+ * RETURNS
+ *      TRUE <=> written OK, FALSE else.
+ *----------------------------------------------------------------------------*/
+
+bool_t add_span(
+    VGATHER_T *p_gather,        /* What we're writing */
+    const char *p_chars,        /* The text */
+    uint32_t numchars           /* Number of characters */
+    )
+{
+    bool_t ret = TRUE;
+
+    struct iovec *p_last = p_gather->n_spans ? &(p_gather->spans[p_gather->n_spans - 1]) : NULL;
+
+    if (0 == numchars)
+    {
+        /* Nothing to add */
+    }
+    else
+    if (p_last && (((char *)p_last->iov_base + p_last->iov_len) == p_chars))
+    {
+        p_last->iov_len += numchars;
+    }
+    else
+    {
+        if (VFGATHERMAXSPANS == p_gather->n_spans)
+        {
+            ret = flush_gather(p_gather);
+        }
+
+        if (ret)
+        {
+            p_gather->spans[p_gather->n_spans].iov_base = (void *)p_chars;
+            p_gather->spans[p_gather->n_spans].iov_len = numchars;
+            p_gather->n_spans++;
+        }
+    }
+
+    return ret;
+}
+#endif
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      flush_gather()
+ * 
+ * DESCRIPTION
+ *      Write out everything gathered so far, coping with short writes.
+ *
+ * RETURNS
+ *      TRUE <=> written OK, FALSE else.
+ *----------------------------------------------------------------------------*/
+
+bool_t flush_gather(
+    VGATHER_T *p_gather         /* What we're writing */
+    )
+{
+    bool_t ret = TRUE;
+
+#if defined(HAS_SYS_UIO_H)
+    struct iovec *p_span = p_gather->spans;
+    int n_spans = (int)p_gather->n_spans;
+
+    while (ret && (0 < n_spans))
+    {
+        ssize_t written = writev(p_gather->fd, p_span, n_spans);
+
+        if (0 < written)
+        {
+            while ((0 < n_spans) && ((size_t)written >= p_span->iov_len))
+            {
+                written -= (ssize_t)p_span->iov_len;
+                p_span++;
+                n_spans--;
+            }
+
+            if (0 < n_spans)
+            {
+                p_span->iov_base = (char *)p_span->iov_base + written;
+                p_span->iov_len -= (size_t)written;
+            }
+        }
+        else
+        if (0 == written)
+        {
+            /* No progress and no error to say why, retrying would spin */
+
+            ret = FALSE;
+        }
+        else
+        {
+            ret = (bool_t)(EINTR == errno);
+        }
+    }
+
+    p_gather->n_spans = 0;
+#else
+    ret = write_to_fd(p_gather->fd, p_gather->buffer, p_gather->length);
+#endif
+
+    p_gather->length = 0;
+
+    return ret;
+}
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      write_to_fd()
  * 
  * DESCRIPTION
- *      Wrapper on fwrite().
+ *      Wrapper on write(), coping with short writes.  A write() which
+ *      returns 0 is treated as a failure rather than retried.
  *
  * RETURNS
  *      TRUE <=> written OK, FALSE else.
  *----------------------------------------------------------------------------*/
 
-bool_t write_to_stdio(
-    FILE *fp,                   /* The FILE* we're writing to */
-    char *p_buffer,             /* The buffer to fo whatever you're going to do */
-    uint32_t charcount          /* Number of characters in the buffer */
+bool_t write_to_fd(
+    int fd,                     /* Where it's going */
+    const char *p_chars,        /* The text */
+    size_t numchars             /* Number of characters */
+    )
+{
+    bool_t ret = TRUE;
+
+    while (ret && (0 < numchars))
+    {
+        int written = (int)write(fd, p_chars, (unsigned int)((numchars < VFGATHERBUFSIZE) ? numchars : VFGATHERBUFSIZE));
+
+        if (0 < written)
+        {
+            p_chars += written;
+            numchars -= (size_t)written;
+        }
+        else
+        if (0 == written)
+        {
+            /* No progress and no error to say why, retrying would spin */
+
+            ret = FALSE;
+        }
+        else
+        {
+            ret = (bool_t)(EINTR == errno);
+        }
+    }
+
+    return ret;
+}
+
+#if defined(HAS_UNISTD_H)
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      write_file_atomic()
+ * 
+ * DESCRIPTION
+ *      Write the object to a new temporary file made by mkstemp() next to
+ *      p_name, so that concurrent writers and stray files never share it.
+ *      It's given the mode of the file it replaces (or of a new file created
+ *      under the current umask) & fsync()ed, then renamed over p_name and
+ *      the directory fsync()ed so that the rename itself is on disk.  The
+ *      temporary file is removed on failure.
+ *
+ * RETURNS
+ *      TRUE <=> written & renamed into place, FALSE else.
+ *---------------------------------------------------------------------------*/
+
+bool_t write_file_atomic(
+    const char *p_name,         /* File to replace */
+    char *p_temp,               /* Template for the temporary file */
+    VF_OBJECT_T *p_object,      /* The object to write */
+    vf_write_flags_t flags      /* Flags controlling operation */
+    )
+{
+    bool_t ret = FALSE;
+    struct stat buf;
+    mode_t mode;
+    int fd;
+
+    if (0 == stat(p_name, &buf))
+    {
+        mode = (mode_t)(buf.st_mode & 07777);
+    }
+    else
+    {
+        /* No umask query which leaves it alone, set it back straight away */
+
+        mode = umask(022);
+        (void)umask(mode);
+
+        mode = (mode_t)(0666 & ~mode);
+    }
+
+    fd = mkstemp(p_temp);
+
+    if (0 <= fd)
+    {
+        ret = (bool_t)(0 == fchmod(fd, mode));
+
+        if (ret)
+        {
+            ret = vf_write_fd(fd, p_object, flags);
+        }
+
+        if (ret)
+        {
+            /* Make sure it's on disk before it replaces anything */
+
+            ret = (bool_t)(0 == fsync(fd));
+        }
+
+        if (0 != close(fd))
+        {
+            ret = FALSE;
+        }
+
+        if (ret)
+        {
+            ret = (bool_t)(0 == rename(p_temp, p_name));
+        }
+
+        if (ret)
+        {
+            ret = sync_directory(p_name);
+        }
+        else
+        {
+            (void)unlink(p_temp);
+        }
+    }
+
+    return ret;
+}
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      sync_directory()
+ * 
+ * DESCRIPTION
+ *      fsync() the directory holding p_name, making a rename into it
+ *      durable.  File systems which can't sync a directory (EINVAL) are
+ *      taken to have nothing to do.
+ *
+ * RETURNS
+ *      TRUE <=> synced, FALSE else.
+ *---------------------------------------------------------------------------*/
+
+bool_t sync_directory(
+    const char *p_name          /* File whose directory is synced */
     )
 {
-    return (bool_t)((charcount == (uint32_t)fwrite(p_buffer, 1, charcount, fp)) ? TRUE : FALSE);
+    bool_t ret = FALSE;
+    const char *p_slash = strrchr(p_name, '/');
+    char *p_dir;
+    size_t length;
+
+    if (!p_slash)
+    {
+        p_name = ".";
+        length = 1;
+    }
+    else
+    if (p_slash == p_name)
+    {
+        length = 1;
+    }
+    else
+    {
+        length = (size_t)(p_slash - p_name);
+    }
+
+    p_dir = (char *)vf_malloc(length + 1);
+
+    if (p_dir)
+    {
+        int fd;
+
+        memcpy(p_dir, p_name, length);
+        p_dir[length] = '\0';
+
+        fd = open(p_dir, O_RDONLY);
+
+        if (0 <= fd)
+        {
+            ret = (bool_t)((0 == fsync(fd)) || (EINVAL == errno));
+
+            if (0 != close(fd))
+            {
+                ret = FALSE;
+            }
+        }
+
+        vf_free(p_dir);
+    }
+
+    return ret;
 }
+#endif
 
 /*============================================================================*
  End Of File
@@ -0,0 +1,308 @@
+/*******************************************************************************
+
+    (C) Nick Marley, 2001 -
+
+    This software is distributed under the GNU Lesser General Public Licence.
+    Please read and understand the comments at the top of vf_iface.h before use!
+
+FILE
+    $Workfile$
+    $Revision$
+    $Author$
+
+ORIGINAL AUTHOR
+    Nick Marley
+
+DESCRIPTION
+    Measuring the text form of an object and writing it to memory.
+
+    Measuring runs the writer just counting (see vf_write_measure()), which
+    skips encoding BASE64 values altogether.  Writing to memory runs it
+    with a sink which copies the text while there's room and counts the
+    lot, so a buffer that's too small still gives the size needed.
+
+REFERENCES
+    (none)
+
+MODIFICATION HISTORY
+ *  $Log$
+ *
+ *******************************************************************************/
+
+#ifndef NORCSID
+static const char vf_write_mem_c_vss_id[] = "$Header$";
+#endif
+
+/*=============================================================================*
+ ANSI C & System-wide Header Files
+ *=============================================================================*/
+
+#include <common/types.h>
+
+#include <string.h>
+
+/*============================================================================*
+ Interface Header Files
+ *============================================================================*/
+
+#include "vformat/vf_iface.h"
+
+/*============================================================================*
+ Local Header File
+ *============================================================================*/
+
+#include "vf_config.h"
+#include "vf_malloc.h"
+#include "vf_internals.h"
+
+/*============================================================================*
+ Public Data
+ *============================================================================*/
+/* None */
+
+/*============================================================================*
+ Private Defines
+ *============================================================================*/
+/* None */
+
+/*============================================================================*
+ Private Data Types
+ *============================================================================*/
+
+/*----------------------------------------------------------------------------*
+ * PURPOSE
+ *      Where the text is going.  Once length passes bufsize nothing more is
+ *      copied, but counting carries on.
+ *----------------------------------------------------------------------------*/
+
+typedef struct
+{
+    char            *p_buffer;          /* Buffer */
+    size_t          bufsize;            /* Size of buffer */
+    size_t          length;             /* Characters produced so far */
+}
+VMEMSINK_T;
+
+/*============================================================================*
+ Private Function Prototypes
+ *============================================================================*/
+
+static bool_t write_to_mem_sink(
+    VF_OBJECT_T *p_object,      /* The object to write */
+    vf_write_flags_t flags,     /* Flags controlling operation */
+    VMEMSINK_T *p_mem           /* Where it's going */
+    );
+
+static bool_t copy_to_mem(
+    void *p_context,            /* The VMEMSINK_T */
+    const char *p_chars,        /* The text */
+    uint32_t numchars,          /* Number of characters */
+    bool_t stable               /* Text stays put till the write's done? */
+    );
+
+/*============================================================================*
+ Private Data
+ *============================================================================*/
+/* None */
+
+/*============================================================================*
+ Public Function Implementations
+ *============================================================================*/
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      vf_measure_object()
+ *
+ * DESCRIPTION
+ *      Find the length of the text form of an object without keeping it.
+ *
+ * RETURNS
+ *      TRUE <=> object could be written, FALSE else.
+ *----------------------------------------------------------------------------*/
+
+bool_t vf_measure_object(
+    VF_OBJECT_T *p_object,      /* The object to measure */
+    vf_write_flags_t flags,     /* Flags controlling operation */
+    size_t *p_length            /* Where to return the length */
+    )
+{
+    bool_t ret = FALSE;
+    VF_WRITER_T *p_writer;
+
+    if (p_length)
+    {
+        *p_length = 0;
+
+        if (p_object && vf_write_init(&p_writer, p_object, flags))
+        {
+            ret = vf_write_measure(p_writer, p_length);
+
+            vf_write_end(p_writer);
+        }
+    }
+
+    return ret;
+}
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      vf_write_to_mem()
+ *
+ * DESCRIPTION
+ *      Write the text form of an object to a buffer in one go.  If
+ *      *pp_buffer is NULL a buffer of exactly the right size (plus a NULL
+ *      terminator) is allocated from the library heap and passed back,
+ *      otherwise the text goes into the bufsize bytes at *pp_buffer.
+ *
+ * RETURNS
+ *      TRUE <=> written OK, FALSE else.  *p_length gives the length of the
+ *      text, or the size of buffer needed if the one provided was too small.
+ *----------------------------------------------------------------------------*/
+
+bool_t vf_write_to_mem(
+    VF_OBJECT_T *p_object,      /* The object to write */
+    vf_write_flags_t flags,     /* Flags controlling operation */
+    char **pp_buffer,           /* Buffer, *pp_buffer NULL => allocate one */
+    size_t bufsize,             /* Size of caller's buffer */
+    size_t *p_length            /* Where to return the length */
+    )
+{
+    bool_t ret = FALSE;
+
+    if (pp_buffer && p_length)
+    {
+        VMEMSINK_T mem;
+
+        mem.p_buffer = *pp_buffer;
+        mem.bufsize = bufsize;
+        mem.length = 0;
+
+        if (!mem.p_buffer)
+        {
+            if (vf_measure_object(p_object, flags, &(mem.bufsize)) && (mem.bufsize < 0xFFFFFFFFUL))
+            {
+                mem.p_buffer = (char *)vf_malloc((uint32_t)(mem.bufsize + 1));
+            }
+        }
+
+        if (mem.p_buffer)
+        {
+            ret = write_to_mem_sink(p_object, flags, &mem);
+
+            if (mem.length > mem.bufsize)
+            {
+                ret = FALSE;
+            }
+
+            if (!*pp_buffer)
+            {
+                if (ret)
+                {
+                    mem.p_buffer[mem.length] = '\0';
+
+                    *pp_buffer = mem.p_buffer;
+                }
+                else
+                {
+                    vf_free(mem.p_buffer);
+                }
+            }
+        }
+
+        *p_length = mem.length;
+    }
+
+    return ret;
+}
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      vf_free_mem()
+ *
+ * DESCRIPTION
+ *      Release a buffer allocated by vf_write_to_mem().
+ *
+ * RETURNS
+ *      (none)
+ *----------------------------------------------------------------------------*/
+
+void vf_free_mem(
+    char *p_buffer              /* Buffer to free */
+    )
+{
+    if (p_buffer)
+    {
+        vf_free(p_buffer);
+    }
+}
+
+/*============================================================================*
+ Private Function Implementations
+ *============================================================================*/
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      write_to_mem_sink()
+ *
+ * DESCRIPTION
+ *      Run a writer over the object into a VMEMSINK_T.
+ *
+ * RETURNS
+ *      TRUE <=> object could be written, FALSE else.
+ *----------------------------------------------------------------------------*/
+
+bool_t write_to_mem_sink(
+    VF_OBJECT_T *p_object,      /* The object to write */
+    vf_write_flags_t flags,     /* Flags controlling operation */
+    VMEMSINK_T *p_mem           /* Where it's going */
+    )
+{
+    bool_t ret = FALSE;
+    VF_WRITER_T *p_writer;
+
+    if (p_object && vf_write_init(&p_writer, p_object, flags))
+    {
+        ret = vf_write_to_sink(p_writer, copy_to_mem, p_mem);
+
+        vf_write_end(p_writer);
+    }
+
+    return ret;
+}
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      copy_to_mem()
+ *
+ * DESCRIPTION
+ *      Writer sink.  Count the text and copy it if it fits.
+ *
+ * RETURNS
+ *      TRUE.
+ *----------------------------------------------------------------------------*/
+
+bool_t copy_to_mem(
+    void *p_context,            /* The VMEMSINK_T */
+    const char *p_chars,        /* The text */
+    uint32_t numchars,          /* Number of characters */
+    bool_t stable               /* Text stays put till the write's done? */
+    )
+{
+    VMEMSINK_T *p_mem = (VMEMSINK_T *)p_context;
+
+    (void)stable;
+
+    if ((p_mem->length <= p_mem->bufsize) &&
+        (numchars <= (p_mem->bufsize - p_mem->length)))
+    {
+        memcpy(p_mem->p_buffer + p_mem->length, p_chars, numchars);
+    }
+
+    p_mem->length += numchars;
+
+    return TRUE;
+}
+
+/*============================================================================*
+ End Of File
+ *============================================================================*/
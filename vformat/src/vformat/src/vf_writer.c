@@ -17,11 +17,11 @@ DESCRIPTION
     Code for converting a memory object back to the textal representation.
     Used by the various flavours of "writing" calls.
 
-    TODO: reduce the amount of intermediate memory used by the writer, which
-    currently assumes that it can store amounts of text roughly equal to the
-    encoded output of each property.  The buffered text should be stored in
-    such a way that static strings or values taken directly from the object
-    do not need copying to store.
+    Values are written a piece at a time.  Each step of the writer has a
+    budget (see VFWRITECHUNK) and the value encoders stop once it's spent,
+    keeping their place in the value in the writer's stack, so text waiting
+    for vf_write_to_buf() stays a few K however large the value.  A sink
+    (see vf_write_to_sink()) takes the text as it comes, so gets no budget.
 
 REFERENCES
     (none)    
@@ -94,7 +94,6 @@ static const char vf_writer_c_vss_id[] = "$Header: /cvsroot/vformat/src/vformat/
 
 #include <common/types.h>
 
-#include <ctype.h>
 #include <string.h>
 
 /*============================================================================*
@@ -111,6 +110,8 @@ static const char vf_writer_c_vss_id[] = "$Header: /cvsroot/vformat/src/vformat/
 #include "vf_internals.h"
 #include "vf_malloc.h"
 #include "vf_strings.h"
+#include "vf_string_arrays.h"
+#include "vf_atoms.h"
 
 /*============================================================================*
  Public Data
@@ -125,10 +126,29 @@ static const char vf_writer_c_vss_id[] = "$Header: /cvsroot/vformat/src/vformat/
 #define VFQPMAXPERLINE              (76)
 #endif
 
+#if !defined(VFQPBLOCKSIZE)
+#define VFQPBLOCKSIZE               (4096)
+#endif
+
+/*
+ * The most text encoded from a value for each step of vf_write_to_buf()
+ * (less if the caller's buffer is smaller).  At least one line of BASE64
+ * or one quoted character is always written.
+ */
+#if !defined(VFWRITECHUNK)
+#define VFWRITECHUNK                (4096)
+#endif
+
+#define VW_NO_BUDGET                ((uint32_t)0xFFFFFFFF)
+
 #if !defined(VFBASE64MAXPERLINE)
 #define VFBASE64MAXPERLINE          (64)
 #endif
 
+#if !defined(VFBASE64BLOCKLINES)
+#define VFBASE64BLOCKLINES          (64)
+#endif
+
 #define VW_WRITE_BEGIN              ((vw_state_t)0)
 #define VW_WRITE_NAME               ((vw_state_t)1)
 #define VW_WRITE_VALUE              ((vw_state_t)2)
@@ -146,6 +166,8 @@ typedef struct VWRITER_STACK_T
     VOBJECT_T *p_vobject;           /* The object we're currently writing */
     VPROP_T *p_prop;                /* The current property being written */
     uint32_t index;                 /* Index into string arrays we're writing at */
+    uint32_t offset;                /* Position in the value string or data we're writing */
+    bool_t verbatim;                /* Lazy BASE64 value being written as read? */
     vw_state_t vw_state;            /* State variable for the property writer */
     struct VWRITER_STACK_T *p_prev; /* Previous nested entry */
 }
@@ -155,8 +177,13 @@ typedef struct VWRITER_T
 {
     vf_write_flags_t flags;         /* Flags controlling operation */
     char *p_saved_text;             /* Formatted but not yet written to buffer */
-    uint16_t saved_posn;            /* Position in buffered text */
-    uint16_t saved_length;          /* Length of saved text */
+    uint32_t saved_posn;            /* Position in buffered text */
+    uint32_t saved_length;          /* Length of saved text */
+    uint32_t saved_alloc;           /* Bytes allocated in p_saved_text */
+    vf_write_sink_t p_sink;         /* Takes text as it's generated, if set */
+    void *p_sink_context;           /* Context passed to p_sink */
+    bool_t measuring;               /* Only the length of the text wanted? */
+    uint32_t budget;                /* Characters the current step may still produce */
     VOBJECT_T *p_top_vobject;       /* The object we started writing */
     VWRITER_STACK_T *p_stack;       /* Stack of possibly nested state machines */
     uint16_t charsonline;           /* Number of characters since last newline */
@@ -180,6 +207,18 @@ static bool_t push_text_to_store(
     const char *p_text              /* The text we're saving */
     );
 
+static bool_t push_stable_text_to_store(
+    VWRITER_T *p_vwriter,           /* The writer encapsulation */
+    const char *p_text              /* Text belonging to the object */
+    );
+
+static bool_t push_chars_to_store(
+    VWRITER_T *p_vwriter,           /* The writer encapsulation */
+    const char *p_chars,            /* The characters we're saving */
+    uint32_t numchars,              /* Number of characters */
+    bool_t stable                   /* Characters stay put till we're done? */
+    );
+
 static bool_t write_name_fields(
     VWRITER_T *p_vwriter            /* The writer encapsulation */
     );
@@ -188,19 +227,30 @@ static bool_t write_value_fields(
     VWRITER_T *p_vwriter            /* The writer encapsulation */
     );
 
-static bool_t write_quoted_printable(
+static bool_t write_7bit_chars(
     VWRITER_T *p_vwriter,           /* The writer encapsulation */
     uint32_t n_string               /* Which value string to write */
     );
 
-static bool_t qp_needs_quoting(
-    uint8_t c                       /* Char to test */
+static bool_t write_quoted_printable(
+    VWRITER_T *p_vwriter,           /* The writer encapsulation */
+    uint32_t n_string               /* Which value string to write */
     );
 
 static void at_end_of_property(
     VWRITER_T *p_vwriter            /* The writer encapsulation */
     );
 
+static VOBJECT_T *first_object_to_write(
+    VWRITER_T *p_vwriter,           /* The writer encapsulation */
+    VOBJECT_T *p_vobject            /* Top level object to start from */
+    );
+
+static VPROP_T *first_prop_to_write(
+    VWRITER_T *p_vwriter,           /* The writer encapsulation */
+    VPROP_T *p_prop                 /* Property to start from */
+    );
+
 static void at_end_of_object(
     VWRITER_T *p_vwriter            /* The writer encapsulation */
     );
@@ -209,17 +259,20 @@ static bool_t write_base64_chars(
     VWRITER_T *p_vwriter            /* File we're writing */
     );
 
-static char char_to_base64(
-    uint8_t b                       /* Byte to convert */
+static bool_t write_base64_verbatim(
+    VWRITER_T *p_vwriter            /* File we're writing */
     );
 
-static void char_to_hexadecimal(
-    char *buffer,                   /* Ooutput buffer */
-    char c                          /* Char value to convert */
+static bool_t count_base64_quads(
+    VWRITER_T *p_vwriter,           /* The writer encapsulation */
+    uint32_t n_quads                /* Number of quads we'd write */
     );
 
-static char nibble_to_hexadecimal(
-    int c                           /* Nibble value to convert */
+static bool_t count_chars(
+    void *p_context,                /* The count */
+    const char *p_chars,            /* The text (may be NULL) */
+    uint32_t numchars,              /* Number of characters */
+    bool_t stable                   /* Text stays put till the write's done? */
     );
 
 /*============================================================================*
@@ -228,6 +281,41 @@ static char nibble_to_hexadecimal(
 
 static const char sz_crnl[3] = { 0x0D, 0x0A, 0x00 };
 
+/* Properties written with VFWF_MODIFIEDPROPS whether modified or not */
+
+static const char *identity_props[] =
+{
+    VFP_VERSION, VFP_NAME, VFP_UNIQUESTRING, NULL
+};
+
+static const char base64_alphabet[65] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static const char hex_digits[17] = "0123456789ABCDEF";
+
+/* Characters written as =XX in QUOTED-PRINTABLE values, the rest are
+ * letters, digits and " ,-.!?'" */
+
+static const uint8_t qp_quote[256] =
+{
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,     /* 0x00 */
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,     /* 0x10 */
+    0, 0, 1, 1, 1, 1, 1, 0, 1, 1, 1, 1, 0, 0, 0, 1,     /* 0x20  !"#$%&'()*+,-./ */
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 0,     /* 0x30 0123456789:;<=>? */
+    1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,     /* 0x40 @ABCDEFGHIJKLMNO */
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1,     /* 0x50 PQRSTUVWXYZ[\]^_ */
+    1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,     /* 0x60 `abcdefghijklmno */
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1,     /* 0x70 pqrstuvwxyz{|}~  */
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,     /* 0x80 */
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,     /* 0x90 */
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,     /* 0xA0 */
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,     /* 0xB0 */
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,     /* 0xC0 */
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,     /* 0xD0 */
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,     /* 0xE0 */
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1      /* 0xF0 */
+};
+
 /*============================================================================*
  Public Function Implementations
  *============================================================================*/
@@ -243,8 +331,8 @@ static const char sz_crnl[3] = { 0x0D, 0x0A, 0x00 };
  *
  *      Various flags are available to influence which parts of the object
  *      are streamed.  It is up to the caller to provide buffer space for
- *      the conversion (see vf_write_to_buf()).  Usually the process looks
- *      like this:
+ *      the conversion (see vf_write_to_buf() and vf_write_to_buf_ex()).
+ *      Usually the process looks like this:
  *
  *          VF_WRITER_T *p_writer;
  *
@@ -303,9 +391,20 @@ bool_t vf_write_init(
                 p_vwriter->p_top_vobject = (VOBJECT_T *)p_object;
 
                 /* Initialise with flattening the object */
-                p_vwriter->p_stack->p_vobject = (VOBJECT_T *)p_object;
-                p_vwriter->p_stack->p_prop = p_vwriter->p_stack->p_vobject->p_props;
-                p_vwriter->p_stack->vw_state = VW_WRITE_BEGIN;
+                p_vwriter->p_stack->p_vobject = first_object_to_write(p_vwriter, (VOBJECT_T *)p_object);
+
+                if (p_vwriter->p_stack->p_vobject)
+                {
+                    p_vwriter->p_stack->p_prop = first_prop_to_write(p_vwriter, p_vwriter->p_stack->p_vobject->p_props);
+                    p_vwriter->p_stack->vw_state = VW_WRITE_BEGIN;
+                }
+                else
+                {
+                    /* Nothing to write, the writer produces no text */
+
+                    vf_free(p_vwriter->p_stack);
+                    p_vwriter->p_stack = NULL;
+                }
 
                 /* Pass back handle to writer object */
                 *pp_writer = (VF_WRITER_T *)p_vwriter;
@@ -341,6 +440,38 @@ bool_t vf_write_to_buf(
     uint16_t bufsize,               /* Size of buffer */
     uint16_t *p_byteswritten        /* Ptr to return count via */
     )
+{
+    size_t byteswritten = 0;
+    bool_t ret = FALSE;
+
+    if (p_byteswritten)
+    {
+        ret = vf_write_to_buf_ex(p_writer, p_buffer, bufsize, &byteswritten);
+
+        *p_byteswritten = (uint16_t)byteswritten;
+    }
+
+    return ret;
+}
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      vf_write_to_buf_ex()
+ * 
+ * DESCRIPTION
+ *      As vf_write_to_buf() but without the 64K limit on the buffer size.
+ *
+ * RETURNS
+ *      TRUE <=> written OK, FALSE else.  Consult the *p_byteswritten value
+ *      to determine if the conversion operation has finished.
+ *----------------------------------------------------------------------------*/
+
+bool_t vf_write_to_buf_ex(
+    VF_WRITER_T *p_writer,          /* The writer we're asking to write */
+    char *p_buffer,                 /* Buffer to write to */
+    size_t bufsize,                 /* Size of buffer */
+    size_t *p_byteswritten          /* Ptr to return count via */
+    )
 {
     VWRITER_T *p_vwriter = (VWRITER_T *)p_writer;
     bool_t ret = FALSE;
@@ -349,7 +480,7 @@ bool_t vf_write_to_buf(
     {
         ret = TRUE;
 
-        *p_byteswritten = '\0';
+        *p_byteswritten = 0;
 
         do
         {
@@ -357,46 +488,132 @@ bool_t vf_write_to_buf(
              * If we have any text left over after the last
              * iteration, copy this into the buffer first.
              */
-            if (p_vwriter->p_saved_text)
+            if (p_vwriter->saved_posn < p_vwriter->saved_length)
             {
-                uint16_t remlen = strlen(p_vwriter->p_saved_text + p_vwriter->saved_posn);
+                uint32_t remlen = p_vwriter->saved_length - p_vwriter->saved_posn;
 
-                uint16_t bytestocopy = (remlen < bufsize) ? remlen : bufsize;
+                size_t bytestocopy = (remlen < bufsize) ? remlen : bufsize;
 
                 memcpy(p_buffer, p_vwriter->p_saved_text + p_vwriter->saved_posn, bytestocopy);
             
-                p_vwriter->saved_posn += bytestocopy;
+                p_vwriter->saved_posn += (uint32_t)bytestocopy;
 
                 bufsize -= bytestocopy;
                 p_buffer += bytestocopy;
 
                 *p_byteswritten += bytestocopy;
 
-                if ('\0' == p_vwriter->p_saved_text[p_vwriter->saved_posn])
+                if (p_vwriter->saved_posn == p_vwriter->saved_length)
                 {
-                    vf_free(p_vwriter->p_saved_text);
-                    p_vwriter->p_saved_text = NULL;
+                    /* Keep the store for the next lot */
 
                     p_vwriter->saved_posn = 0;
+                    p_vwriter->saved_length = 0;
                 }
             }
 
             /*
              * If there's space left in the buffer and we've emptied our store
              * of text cached from last time then generate some more text.
+             * Some steps (the end of an object say) produce none, so keep
+             * going till there's text or we've finished.
              */
-            if ((0 < bufsize) && !p_vwriter->p_saved_text && p_vwriter->p_stack)
+            if ((0 < bufsize) && (0 == p_vwriter->saved_length) && p_vwriter->p_stack)
             {
+                p_vwriter->budget = (bufsize < VFWRITECHUNK) ? (uint32_t)bufsize : VFWRITECHUNK;
+
                 ret = get_text_from_vobject(p_vwriter);
             }
         }
-        while (ret && (0 < bufsize) && p_vwriter->p_saved_text && p_vwriter->p_stack)
+        while (ret && (0 < bufsize) && (p_vwriter->saved_length || p_vwriter->p_stack))
             ;
+    }
+
+    return ret;
+}
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      vf_write_to_sink()
+ * 
+ * DESCRIPTION
+ *      Run a writer to completion, passing the text to a sink as it's
+ *      generated rather than saving it up for vf_write_to_buf().
+ *
+ * RETURNS
+ *      TRUE <=> written OK, FALSE else.
+ *----------------------------------------------------------------------------*/
 
-        if (!ret)
+bool_t vf_write_to_sink(
+    VF_WRITER_T *p_writer,          /* The writer */
+    vf_write_sink_t p_sink,         /* Where the text goes */
+    void *p_context                 /* Context passed to p_sink */
+    )
+{
+    VWRITER_T *p_vwriter = (VWRITER_T *)p_writer;
+    bool_t ret = FALSE;
+
+    if (p_vwriter && p_sink)
+    {
+        ret = TRUE;
+
+        /* Anything left over from vf_write_to_buf() goes first */
+
+        if (p_vwriter->saved_posn < p_vwriter->saved_length)
         {
-            deallocate_writer(p_vwriter);
+            ret = p_sink(p_context, p_vwriter->p_saved_text + p_vwriter->saved_posn,
+                p_vwriter->saved_length - p_vwriter->saved_posn, FALSE);
+
+            p_vwriter->saved_posn = 0;
+            p_vwriter->saved_length = 0;
         }
+
+        p_vwriter->p_sink = p_sink;
+        p_vwriter->p_sink_context = p_context;
+
+        while (ret && p_vwriter->p_stack)
+        {
+            p_vwriter->budget = VW_NO_BUDGET;
+
+            ret = get_text_from_vobject(p_vwriter);
+        }
+
+        p_vwriter->p_sink = NULL;
+        p_vwriter->p_sink_context = NULL;
+    }
+
+    return ret;
+}
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      vf_write_measure()
+ * 
+ * DESCRIPTION
+ *      Run a writer to completion, just counting the text.  BASE64 values
+ *      aren't encoded, their length follows from the number of bytes.
+ *
+ * RETURNS
+ *      TRUE <=> object could be written, FALSE else.
+ *----------------------------------------------------------------------------*/
+
+bool_t vf_write_measure(
+    VF_WRITER_T *p_writer,          /* The writer */
+    size_t *p_length                /* Where to return the length */
+    )
+{
+    VWRITER_T *p_vwriter = (VWRITER_T *)p_writer;
+    bool_t ret = FALSE;
+
+    if (p_vwriter && p_length)
+    {
+        *p_length = 0;
+
+        p_vwriter->measuring = TRUE;
+
+        ret = vf_write_to_sink(p_writer, count_chars, p_length);
+
+        p_vwriter->measuring = FALSE;
     }
 
     return ret;
@@ -452,7 +669,7 @@ bool_t get_text_from_vobject(
         {
             ret &= push_text_to_store(p_vwriter, VFP_BEGIN);
             ret &= push_text_to_store(p_vwriter, ":");
-            ret &= push_text_to_store(p_vwriter, p_vwriter->p_stack->p_vobject->p_type);
+            ret &= push_stable_text_to_store(p_vwriter, p_vwriter->p_stack->p_vobject->p_type);
             ret &= push_text_to_store(p_vwriter, sz_crnl);
 
             p_vwriter->p_stack->vw_state = VW_WRITE_NAME;
@@ -490,7 +707,7 @@ bool_t get_text_from_vobject(
         {
             ret &= push_text_to_store(p_vwriter, VFP_END);
             ret &= push_text_to_store(p_vwriter, ":");
-            ret &= push_text_to_store(p_vwriter, p_vwriter->p_stack->p_vobject->p_type);
+            ret &= push_stable_text_to_store(p_vwriter, p_vwriter->p_stack->p_vobject->p_type);
             ret &= push_text_to_store(p_vwriter, sz_crnl);
 
             p_vwriter->p_stack->vw_state = VW_WRITE_DONE;
@@ -537,14 +754,14 @@ bool_t write_name_fields(
     {
         if (p_vwriter->p_stack->p_prop->p_group)
         {
-            ret &= push_text_to_store(p_vwriter, p_vwriter->p_stack->p_prop->p_group);
+            ret &= push_stable_text_to_store(p_vwriter, p_vwriter->p_stack->p_prop->p_group);
             ret &= push_text_to_store(p_vwriter, ".");
         }
     }
 
-    if (ret && p_strarray->pp_strings)
+    if (ret)
     {
-        if (p_vwriter->p_stack->index < p_strarray->n_strings)
+        if (p_strarray->pp_strings && (p_vwriter->p_stack->index < p_strarray->n_strings))
         {
             char *p_name_field = p_strarray->pp_strings[p_vwriter->p_stack->index];
 
@@ -554,7 +771,7 @@ bool_t write_name_fields(
             }
             if (p_name_field && (0 < p_strlen(p_name_field)))
             {
-                ret &= push_text_to_store(p_vwriter, p_name_field);
+                ret &= push_stable_text_to_store(p_vwriter, p_name_field);
             }
 
             p_vwriter->p_stack->index += 1;
@@ -577,10 +794,9 @@ bool_t write_name_fields(
  *      write_value_fields()
  * 
  * DESCRIPTION
- *      Continue writing the value parts of the current property.
- *
- *      TODO: don't send all value fields in one go - send them one at
- *      a time.  Again, this will reduce memory requirements.
+ *      Continue writing the value parts of the current property, as much
+ *      as the writer's budget allows.  The stack entry's index and offset
+ *      say where we've got to.
  *
  * RETURNS
  *      TRUE iff memory allocation OK, FALSE else.
@@ -603,7 +819,7 @@ bool_t write_value_fields(
                 memset(p_new, '\0', sizeof(VWRITER_STACK_T));
 
                 p_new->p_vobject = p_vwriter->p_stack->p_prop->value.v.o.p_object;
-                p_new->p_prop = p_new->p_vobject->p_props;
+                p_new->p_prop = first_prop_to_write(p_vwriter, p_new->p_vobject->p_props);
                 p_new->vw_state = VW_WRITE_BEGIN;
                 p_new->p_prev = p_vwriter->p_stack;
 
@@ -617,44 +833,49 @@ bool_t write_value_fields(
         break;
 
     case VF_ENC_7BIT:
+    case VF_ENC_QUOTEDPRINTABLE:
         {
-            uint32_t n;
+            VWRITER_STACK_T *p_stack = p_vwriter->p_stack;
+            VSTRARRAY_T *p_strings = &(p_stack->p_prop->value.v.s);
+            bool_t qp = (bool_t)(VF_ENC_QUOTEDPRINTABLE == p_stack->p_prop->value.encoding);
 
-            for (n = 0;ret && (n < p_vwriter->p_stack->p_prop->value.v.s.n_strings);n++)
+            if (qp)
             {
-                if (n)
-                    ret &= push_text_to_store(p_vwriter, ";");
-
-                if (p_vwriter->p_stack->p_prop->value.v.s.pp_strings[n])
-                {
-                    ret &= push_text_to_store(p_vwriter, p_vwriter->p_stack->p_prop->value.v.s.pp_strings[n]);
-                }
+                ret = decode_lazy_value(p_stack->p_prop);
             }
 
-            ret &= push_text_to_store(p_vwriter, sz_crnl);
+            /* As many of the fields as the budget allows */
 
-            at_end_of_property(p_vwriter);
-        }
-        break;
+            while (ret && p_vwriter->budget && (p_stack->index < p_strings->n_strings))
+            {
+                const char *p_string = p_strings->pp_strings[p_stack->index];
 
-    case VF_ENC_QUOTEDPRINTABLE:
-        {
-            uint32_t n;
+                if (p_stack->index && (0 == p_stack->offset))
+                {
+                    ret = push_text_to_store(p_vwriter, ";");
+                }
 
-            for (n = 0;ret && (n < p_vwriter->p_stack->p_prop->value.v.s.n_strings);n++)
-            {
-                if (n)
-                    ret &= push_text_to_store(p_vwriter, ";");
+                if (ret && p_string)
+                {
+                    ret = qp ? write_quoted_printable(p_vwriter, p_stack->index) :
+                        write_7bit_chars(p_vwriter, p_stack->index);
+                }
 
-                if (p_vwriter->p_stack->p_prop->value.v.s.pp_strings[n])
+                if (!p_string || ('\0' == p_string[p_stack->offset]))
                 {
-                    ret &= write_quoted_printable(p_vwriter, n);
-                }                    
+                    p_stack->index += 1;
+                    p_stack->offset = 0;
+                }
             }
 
-            ret &= push_text_to_store(p_vwriter, sz_crnl);
+            if (ret && (p_stack->index >= p_strings->n_strings))
+            {
+                ret = push_text_to_store(p_vwriter, sz_crnl);
+
+                p_stack->index = 0;
 
-            at_end_of_property(p_vwriter);
+                at_end_of_property(p_vwriter);
+            }
         }
         break;
 
@@ -666,11 +887,42 @@ bool_t write_value_fields(
 
     case VF_ENC_BASE64:
         {
-            ret &= write_base64_chars(p_vwriter);
+            VWRITER_STACK_T *p_stack = p_vwriter->p_stack;
+            uint32_t length;
 
-            ret &= push_text_to_store(p_vwriter, sz_crnl);
+            if (0 == p_stack->offset)
+            {
+                /* Starting the value, this needn't be looked at again */
 
-            at_end_of_property(p_vwriter);
+                p_stack->verbatim = lazy_value_verbatim(p_stack->p_prop);
+
+                if (!p_stack->verbatim)
+                {
+                    ret = decode_lazy_value(p_stack->p_prop);
+                }
+            }
+
+            if (p_stack->verbatim)
+            {
+                length = (p_stack->p_prop->value.v.b.n_bufsize / 4) * 4;
+
+                ret &= write_base64_verbatim(p_vwriter);
+            }
+            else
+            {
+                length = p_stack->p_prop->value.v.b.n_bufsize;
+
+                ret = (bool_t)(ret && write_base64_chars(p_vwriter));
+            }
+
+            if (ret && (p_stack->offset >= length))
+            {
+                ret = push_text_to_store(p_vwriter, sz_crnl);
+
+                p_stack->offset = 0;
+
+                at_end_of_property(p_vwriter);
+            }
         }
         break;
 
@@ -701,9 +953,11 @@ void at_end_of_property(
     VWRITER_T *p_vwriter            /* The writer encapsulation */
     )
 {
-    if (p_vwriter->p_stack->p_prop->p_next)
+    VPROP_T *p_next = first_prop_to_write(p_vwriter, p_vwriter->p_stack->p_prop->p_next);
+
+    if (p_next)
     {
-        p_vwriter->p_stack->p_prop = p_vwriter->p_stack->p_prop->p_next;
+        p_vwriter->p_stack->p_prop = p_next;
         p_vwriter->p_stack->vw_state = VW_WRITE_NAME;
     }
     else
@@ -719,7 +973,8 @@ void at_end_of_property(
  * DESCRIPTION
  *      Called when finished writing a n object.  Checks to see if there's
  *      another object and if not pops the current obejct off the stack to
- *      return from a "recursive" operation.
+ *      return from a "recursive" operation.  With VFWF_ONEOBJECT the list
+ *      of top level objects stops at the first.
  *
  * RETURNS
  *      (none)
@@ -729,13 +984,27 @@ void at_end_of_object(
     VWRITER_T *p_vwriter            /* The writer encapsulation */
     )
 {
-    p_vwriter->p_stack->p_vobject = p_vwriter->p_stack->p_vobject->p_next;
+    if ((p_vwriter->flags & VFWF_ONEOBJECT) && !p_vwriter->p_stack->p_prev)
+    {
+        /* Just the top level object we were given */
+
+        p_vwriter->p_stack->p_vobject = NULL;
+    }
+    else
+    if (!p_vwriter->p_stack->p_prev)
+    {
+        p_vwriter->p_stack->p_vobject = first_object_to_write(p_vwriter, p_vwriter->p_stack->p_vobject->p_next);
+    }
+    else
+    {
+        p_vwriter->p_stack->p_vobject = p_vwriter->p_stack->p_vobject->p_next;
+    }
 
     if (p_vwriter->p_stack->p_vobject)
     {
         /* Next object in list of objects */
 
-        p_vwriter->p_stack->p_prop = p_vwriter->p_stack->p_vobject->p_props;
+        p_vwriter->p_stack->p_prop = first_prop_to_write(p_vwriter, p_vwriter->p_stack->p_vobject->p_props);
         p_vwriter->p_stack->vw_state = VW_WRITE_BEGIN;
     }
     else
@@ -756,157 +1025,215 @@ void at_end_of_object(
 
 /*----------------------------------------------------------------------------*
  * NAME
- *      write_quoted_printable()
+ *      first_object_to_write()
  * 
  * DESCRIPTION
- *      Write the indicated field back to the file in quoted printable format.
- *
- *      TODO: don't send all value fields in one go - send them one at
- *      a time.  Again, this will reduce memory requirements.
+ *      Find the first top level object from p_vobject on which is to be
+ *      written.  With VFWF_MODIFIEDOBJECTS that's the first modified one,
+ *      looking no further than p_vobject itself with VFWF_ONEOBJECT.
  *
  * RETURNS
- *      TRUE iff memory allocation succeeds, FALSE else.
+ *      The object, NULL if there are none left.
  *----------------------------------------------------------------------------*/
 
-static bool_t write_quoted_printable(
+VOBJECT_T *first_object_to_write(
     VWRITER_T *p_vwriter,           /* The writer encapsulation */
-    uint32_t n_string               /* Which value string to write */
+    VOBJECT_T *p_vobject            /* Top level object to start from */
     )
 {
-    uint32_t i;
-    bool_t ret;
-
-    char *s = p_vwriter->p_stack->p_prop->value.v.s.pp_strings[n_string];
-
-    for (i = 0, ret = TRUE;ret && s;i++)
+    if (p_vwriter->flags & VFWF_MODIFIEDOBJECTS)
     {
-        uint8_t c = s[i];
-
-        if ('\0' == c)
+        while (p_vobject && !p_vobject->modified)
         {
-            break;
+            p_vobject = (p_vwriter->flags & VFWF_ONEOBJECT) ? NULL : p_vobject->p_next;
         }
-        else
+    }
+
+    return p_vobject;
+}
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      first_prop_to_write()
+ * 
+ * DESCRIPTION
+ *      Find the first property from p_prop on which is to be written.  With
+ *      VFWF_MODIFIEDPROPS that's the first which has been modified, holds
+ *      an object which has been, or is one of identity_props[].
+ *
+ * RETURNS
+ *      The property, NULL if there are none left.
+ *----------------------------------------------------------------------------*/
+
+VPROP_T *first_prop_to_write(
+    VWRITER_T *p_vwriter,           /* The writer encapsulation */
+    VPROP_T *p_prop                 /* Property to start from */
+    )
+{
+    if (p_vwriter->flags & VFWF_MODIFIEDPROPS)
+    {
+        for (;p_prop;p_prop = p_prop->p_next)
         {
-            if (3 + p_vwriter->charsonline > VFQPMAXPERLINE)
+            const char *p_name = p_prop->name.n_strings ? p_prop->name.pp_strings[0] : NULL;
+            uint32_t i;
+
+            if (p_prop->modified)
             {
-                push_text_to_store(p_vwriter, "=");
-                push_text_to_store(p_vwriter, sz_crnl);
+                break;
             }
 
-            if (qp_needs_quoting(c))
+            if ((VF_ENC_VOBJECT == p_prop->value.encoding) &&
+                p_prop->value.v.o.p_object && p_prop->value.v.o.p_object->modified)
             {
-                char buffer[5];
-                
-                char_to_hexadecimal(buffer, c);
+                break;
+            }
 
-                push_text_to_store(p_vwriter, "=");
-                push_text_to_store(p_vwriter, buffer);
+            for (i = 0;p_name && identity_props[i];i++)
+            {
+                const char *p_atom = atom_find(identity_props[i], p_strlen(identity_props[i]), FALSE);
 
-                if (0x0D == c)
+                if (ATOM_MATCH(p_name, identity_props[i], p_atom))
                 {
-                    push_text_to_store(p_vwriter, "=");
-                    push_text_to_store(p_vwriter, sz_crnl);
+                    break;
                 }
             }
-            else
-            {
-                char buffer[2];
-                buffer[0] = c;
-                buffer[1] = '\0';
 
-                ret &= push_text_to_store(p_vwriter, buffer);
+            if (p_name && identity_props[i])
+            {
+                break;
             }
         }
     }
 
-    return ret;
+    return p_prop;
 }
 
 /*----------------------------------------------------------------------------*
  * NAME
- *      char_to_hexadecimal()
+ *      write_7bit_chars()
  * 
  * DESCRIPTION
- *      Convert indicated character value to two digit hex string.
+ *      Write as much of the indicated field as the budget allows, carrying
+ *      on from the stack entry's offset.  The text is the object's own.
  *
  * RETURNS
- *      (none)
+ *      TRUE iff memory allocation succeeds, FALSE else.
  *----------------------------------------------------------------------------*/
 
-void char_to_hexadecimal(
-    char *buffer,                   /* Ooutput buffer */
-    char c                          /* Char value to convert */
+bool_t write_7bit_chars(
+    VWRITER_T *p_vwriter,           /* The writer encapsulation */
+    uint32_t n_string               /* Which value string to write */
     )
 {
-    buffer[0] = nibble_to_hexadecimal((c & 0xF0) >> 4);
-    buffer[1] = nibble_to_hexadecimal((c & 0x0F) >> 0);
-    buffer[2] = '\0';
-}
+    bool_t ret = TRUE;
 
-/*----------------------------------------------------------------------------*
- * NAME
- *      nibble_to_hexadecimal()
- * 
- * DESCRIPTION
- *      Convert indicated nibble value to hex character.
- *
- * RETURNS
- *      A hex character.
- *----------------------------------------------------------------------------*/
+    const char *p_text = p_vwriter->p_stack->p_prop->value.v.s.pp_strings[n_string] + p_vwriter->p_stack->offset;
+    uint32_t limit = p_vwriter->budget ? p_vwriter->budget : 1;
+    const char *p_end = (const char *)memchr(p_text, '\0', limit);
+    uint32_t numchars = p_end ? (uint32_t)(p_end - p_text) : limit;
 
-char nibble_to_hexadecimal(
-    int c                           /* Nibble value to convert */
-    )
-{
-    if ((0 <= c) && (c <= 9))
-        return (char)('0' + c);
+    if (numchars)
+    {
+        ret = push_chars_to_store(p_vwriter, p_text, numchars, TRUE);
 
-    if ((0x0A <= c) && (c <= 0x0F))
-        return (char)('A' + (c - 0x0A));
+        p_vwriter->p_stack->offset += numchars;
+    }
 
-    return '?';
+    return ret;
 }
 
 /*----------------------------------------------------------------------------*
  * NAME
- *      qp_needs_quoting()
+ *      write_quoted_printable()
  * 
  * DESCRIPTION
- *      Works out of 'c' needs quoting in quoted printable format.
+ *      Write the indicated field back to the file in quoted printable format.
+ *
+ *      Characters are classified by qp_quote[].  Runs of characters that
+ *      don't need quoting are copied whole, up to where the line needs a
+ *      soft break, and the text is pushed a block at a time.  A quoted CR
+ *      is always followed by a soft break.  Carries on from the stack
+ *      entry's offset and stops there once the budget is spent.
  *
  * RETURNS
- *      TRUE <=> need to quote.
+ *      TRUE iff memory allocation succeeds, FALSE else.
  *----------------------------------------------------------------------------*/
 
-static bool_t qp_needs_quoting(
-    uint8_t c               /* Char to test */
+static bool_t write_quoted_printable(
+    VWRITER_T *p_vwriter,           /* The writer encapsulation */
+    uint32_t n_string               /* Which value string to write */
     )
 {
-    /* TBD - look in the RFC?! */
+    bool_t ret = TRUE;
 
-    bool_t needs_quoting = FALSE;
+    const uint8_t *p_start = (const uint8_t *)p_vwriter->p_stack->p_prop->value.v.s.pp_strings[n_string];
+    const uint8_t *s = p_start + p_vwriter->p_stack->offset;
 
-    switch (c)
+    char block[VFQPBLOCKSIZE];
+    uint32_t used = 0;
+    uint16_t charsonline = p_vwriter->charsonline;
+    bool_t more = TRUE;
+
+    while (ret && more && *s)
     {
-    case ' ':
-    case ',':
-    case '-':
-    case '.':
-    case '!':
-    case '?':
-    case '\'':
-        return FALSE;
+        /* Soft break if a quoted char mightn't fit */
 
-    default:
-        if (isalnum(c))
-            needs_quoting = FALSE;
+        if (3 + charsonline > VFQPMAXPERLINE)
+        {
+            block[used++] = '=';
+            block[used++] = 0x0D;
+            block[used++] = 0x0A;
+            charsonline = 0;
+        }
+
+        if (qp_quote[*s])
+        {
+            block[used++] = '=';
+            block[used++] = hex_digits[*s >> 4];
+            block[used++] = hex_digits[*s & 0x0F];
+            charsonline += 3;
+
+            if (0x0D == *s)
+            {
+                block[used++] = '=';
+                block[used++] = 0x0D;
+                block[used++] = 0x0A;
+                charsonline = 0;
+            }
+
+            s++;
+        }
         else
-            needs_quoting = TRUE;
-        break;
+        {
+            uint32_t n = 1;
+            uint32_t max = (VFQPMAXPERLINE - 2) - charsonline;
+
+            while ((n < max) && !qp_quote[s[n]])
+            {
+                n++;
+            }
+
+            memcpy(block + used, s, n);
+            used += n;
+            charsonline = (uint16_t)(charsonline + n);
+            s += n;
+        }
+
+        /* Push the block before the next step could overflow it */
+
+        if ((0 == *s) || (used + 3 + VFQPMAXPERLINE > VFQPBLOCKSIZE) || (used >= p_vwriter->budget))
+        {
+            ret = push_chars_to_store(p_vwriter, block, used, FALSE);
+            p_vwriter->charsonline = charsonline;
+            used = 0;
+
+            more = (bool_t)(0 < p_vwriter->budget);
+        }
     }
 
-    return needs_quoting;
+    p_vwriter->p_stack->offset = (uint32_t)(s - p_start);
+
+    return ret;
 }
 
 /*----------------------------------------------------------------------------*
@@ -915,7 +1242,10 @@ static bool_t qp_needs_quoting(
  * 
  * DESCRIPTION
  *      Write the indicated binary data stream out to FILE* using BASE64
- *      encoding.
+ *      encoding.  The text is built a block of whole lines at a time, each
+ *      line prefixed by CR/NL and four spaces, and pushed in one go.  We
+ *      carry on from the stack entry's offset, always at the start of a
+ *      line, and stop at the end of a line once the budget is spent.
  *
  * RETURNS
  *      TRUE iff memory allocation succeeds, FALSE else.
@@ -927,104 +1257,173 @@ static bool_t write_base64_chars(
 {
     bool_t ret = TRUE;
 
-    uint8_t *p_buffer = (uint8_t *)p_vwriter->p_stack->p_prop->value.v.b.p_buffer;
-    uint32_t n_chars = p_vwriter->p_stack->p_prop->value.v.b.n_bufsize;
+    uint32_t n_bufsize = p_vwriter->p_stack->p_prop->value.v.b.n_bufsize;
+    const uint8_t *p_buffer = (const uint8_t *)p_vwriter->p_stack->p_prop->value.v.b.p_buffer + p_vwriter->p_stack->offset;
+    uint32_t n_chars = n_bufsize - p_vwriter->p_stack->offset;
+    bool_t more = TRUE;
 
-    uint32_t posn;
-    char quad[5];
-    uint8_t b;
+    char block[VFBASE64BLOCKLINES * (6 + VFBASE64MAXPERLINE)];
 
-    quad[4] = 0;
+    if (p_vwriter->measuring)
+    {
+        ret = count_base64_quads(p_vwriter, (n_chars + 2) / 3);
+
+        n_chars = 0;
+    }
 
-    for (posn = 0;ret && (posn < n_chars);)
+    while (ret && more && (0 < n_chars))
     {
-        int i;
-        uint32_t triplet = 0;
-        uint8_t bits = 0;
+        char *p_text = block;
+        uint32_t n_lines = p_vwriter->budget / (6 + VFBASE64MAXPERLINE);
+        uint32_t line;
 
-        /* Form triplet from data if available */
+        if (n_lines < 1)
+        {
+            n_lines = 1;
+        }
 
-        for (i = 0;i < 3;i++, posn++)
+        if (n_lines > VFBASE64BLOCKLINES)
         {
-            triplet = triplet << 8;
+            n_lines = VFBASE64BLOCKLINES;
+        }
 
-            if (posn < n_chars)
-            {
-                triplet |= *(p_buffer + posn);
+        for (line = 0;(line < n_lines) && (0 < n_chars);line++)
+        {
+            uint32_t n_quads;
 
-                bits += 8;
-            }
-        }
+            p_text[0] = 0x0D;
+            p_text[1] = 0x0A;
+            p_text[2] = ' ';
+            p_text[3] = ' ';
+            p_text[4] = ' ';
+            p_text[5] = ' ';
+            p_text += 6;
 
-        /* Convert the triplet to text */
+            /* Whole triplets */
 
-        for (i = 0;i < 4;i++)
-        {
-            b = (uint8_t)((0xFC0000 & triplet) >> 18);
+            for (n_quads = (VFBASE64MAXPERLINE / 4);(0 < n_quads) && (3 <= n_chars);n_quads--)
+            {
+                uint32_t triplet = ((uint32_t)p_buffer[0] << 16) |
+                                   ((uint32_t)p_buffer[1] << 8) |
+                                   (uint32_t)p_buffer[2];
+
+                p_text[0] = base64_alphabet[triplet >> 18];
+                p_text[1] = base64_alphabet[(triplet >> 12) & 0x3F];
+                p_text[2] = base64_alphabet[(triplet >> 6) & 0x3F];
+                p_text[3] = base64_alphabet[triplet & 0x3F];
+
+                p_text += 4;
+                p_buffer += 3;
+                n_chars -= 3;
+            }
 
-            triplet = triplet << 6;
+            /* One or two bytes left over are padded out with '=' */
 
-            quad[i] = (char)((i <= (bits/6)) ? char_to_base64(b) : '=');
-        }
+            if ((0 < n_quads) && (0 < n_chars))
+            {
+                uint32_t triplet = (uint32_t)p_buffer[0] << 16;
 
-        /* Output the text prefixed by newlines if necessary */
+                if (1 < n_chars)
+                {
+                    triplet |= (uint32_t)p_buffer[1] << 8;
+                }
 
-        if (((posn - 3) % (VFBASE64MAXPERLINE / 4)) == 0)
-        {
-            ret &= push_text_to_store(p_vwriter, sz_crnl);
-            ret &= push_text_to_store(p_vwriter, "    ");
+                p_text[0] = base64_alphabet[triplet >> 18];
+                p_text[1] = base64_alphabet[(triplet >> 12) & 0x3F];
+                p_text[2] = (char)((1 < n_chars) ? base64_alphabet[(triplet >> 6) & 0x3F] : '=');
+                p_text[3] = '=';
+
+                p_text += 4;
+                n_chars = 0;
+            }
         }
 
-        ret &= push_text_to_store(p_vwriter, quad);
+        ret = push_chars_to_store(p_vwriter, block, (uint32_t)(p_text - block), FALSE);
+
+        more = (bool_t)(0 < p_vwriter->budget);
     }
 
+    p_vwriter->p_stack->offset = n_bufsize - n_chars;
+
     return ret;
 }
 
 /*----------------------------------------------------------------------------*
  * NAME
- *      char_to_base64()
+ *      write_base64_verbatim()
  * 
  * DESCRIPTION
- *      Converts byte to BASE64.
+ *      Write BASE64 text which was never decoded (see VFPF_LAZYDECODE), laid
+ *      out in lines exactly as write_base64_chars() would, and stopping
+ *      likewise once the budget is spent.
  *
  * RETURNS
- *      Character encoded.
+ *      TRUE iff memory allocation succeeds, FALSE else.
  *----------------------------------------------------------------------------*/
 
-static char char_to_base64(
-    uint8_t b       /* Byte to convert */
+static bool_t write_base64_verbatim(
+    VWRITER_T *p_vwriter                /* File we're writing */
     )
 {
-    char ret;
+    bool_t ret = TRUE;
 
-    if (b < 26)
-    {
-        ret = (char)(b + 'A');
-    }
-    else
-    if (b < 52)
-    {
-        ret = (char)((b - 26) + 'a');
-    }
-    else
-    if (b < 62)
-    {
-        ret = (char)((b - 52) + '0');
-    }
-    else
-    if (b == 62)
+    uint32_t length = (p_vwriter->p_stack->p_prop->value.v.b.n_bufsize / 4) * 4;
+    const char *p_text = p_vwriter->p_stack->p_prop->value.v.b.p_buffer + p_vwriter->p_stack->offset;
+    uint32_t n_chars = length - p_vwriter->p_stack->offset;
+
+    if (p_vwriter->measuring)
     {
-        ret = '+';
+        ret = count_base64_quads(p_vwriter, n_chars / 4);
+
+        n_chars = 0;
     }
-    else
+
+    while (ret && (0 < n_chars))
     {
-        ret = '/';
+        uint32_t linelen = (n_chars < VFBASE64MAXPERLINE) ? n_chars : VFBASE64MAXPERLINE;
+
+        ret &= push_text_to_store(p_vwriter, sz_crnl);
+        ret &= push_text_to_store(p_vwriter, "    ");
+        ret &= push_chars_to_store(p_vwriter, p_text, linelen, TRUE);
+
+        p_text += linelen;
+        n_chars -= linelen;
+
+        if (0 == p_vwriter->budget)
+        {
+            break;
+        }
     }
 
+    p_vwriter->p_stack->offset = length - n_chars;
+
     return ret;
 }
 
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      count_base64_quads()
+ * 
+ * DESCRIPTION
+ *      Account for the text write_base64_chars() or write_base64_verbatim()
+ *      would produce without producing it, for vf_write_measure().
+ *
+ * RETURNS
+ *      TRUE.
+ *----------------------------------------------------------------------------*/
+
+bool_t count_base64_quads(
+    VWRITER_T *p_vwriter,           /* The writer encapsulation */
+    uint32_t n_quads                /* Number of quads we'd write */
+    )
+{
+    uint32_t n_lines = (n_quads + (VFBASE64MAXPERLINE / 4) - 1) / (VFBASE64MAXPERLINE / 4);
+
+    /* Each line starts with CR/NL and four spaces */
+
+    return push_chars_to_store(p_vwriter, NULL, (4 * n_quads) + (6 * n_lines), FALSE);
+}
+
 /*----------------------------------------------------------------------------*
  * NAME
  *      push_text_to_store()
@@ -1045,39 +1444,107 @@ bool_t push_text_to_store(
     const char *p_text              /* The text we're saving */
     )
 {
-    uint32_t currlen, newlen;
-    char *p_tmp;
-    bool_t ret = TRUE;
-
-    currlen = p_vwriter->p_saved_text ? strlen(p_vwriter->p_saved_text) : 0;
-    newlen = strlen(p_text);
+    bool_t ret = push_chars_to_store(p_vwriter, p_text, strlen(p_text), FALSE);
 
-    p_tmp = (char *)vf_realloc(p_vwriter->p_saved_text, currlen + newlen + 1L);
-    if (p_tmp)
+    if (ret && (p_text == sz_crnl))
     {
-        p_tmp[currlen] = '\0';
+        p_vwriter->charsonline = 0;
+    }
 
-        p_vwriter->p_saved_text = p_tmp;
+    return ret;
+}
 
-        strcat(p_vwriter->p_saved_text, p_text);
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      push_stable_text_to_store()
+ * 
+ * DESCRIPTION
+ *      As push_text_to_store(), for text belonging to the object we're
+ *      writing.  A sink can refer to this rather than copy it.
+ *
+ * RETURNS
+ *      TRUE iff memory allocation succeeds, FALSE else.
+ *----------------------------------------------------------------------------*/
 
-        if (p_text == sz_crnl)
-        {
-            p_vwriter->charsonline = 0;
-        }
-        else
-        {
-            p_vwriter->charsonline += (uint16_t)newlen;
-        }
+bool_t push_stable_text_to_store(
+    VWRITER_T *p_vwriter,           /* The writer encapsulation */
+    const char *p_text              /* Text belonging to the object */
+    )
+{
+    return push_chars_to_store(p_vwriter, p_text, strlen(p_text), TRUE);
+}
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      push_chars_to_store()
+ * 
+ * DESCRIPTION
+ *      Append characters to the cache of text currently waiting.  The cache
+ *      grows geometrically and keeps its length, so writing a property costs
+ *      time in proportion to its length however it's pushed.
+ *
+ *      If the writer has a sink (see vf_write_to_sink()) the characters go
+ *      straight to that instead.
+ *
+ * RETURNS
+ *      TRUE iff memory allocation succeeds, FALSE else.
+ *----------------------------------------------------------------------------*/
+
+bool_t push_chars_to_store(
+    VWRITER_T *p_vwriter,           /* The writer encapsulation */
+    const char *p_chars,            /* The characters we're saving */
+    uint32_t numchars,              /* Number of characters */
+    bool_t stable                   /* Characters stay put till we're done? */
+    )
+{
+    bool_t ret;
+
+    if (p_vwriter->p_sink)
+    {
+        ret = p_vwriter->p_sink(p_vwriter->p_sink_context, p_chars, numchars, stable);
     }
     else
     {
-        ret = FALSE;
+        ret = append_to_buffer(&(p_vwriter->p_saved_text), &(p_vwriter->saved_length),
+            &(p_vwriter->saved_alloc), p_chars, numchars, FALSE);
+    }
+
+    if (ret)
+    {
+        p_vwriter->charsonline += (uint16_t)numchars;
+        p_vwriter->budget -= (numchars < p_vwriter->budget) ? numchars : p_vwriter->budget;
     }
 
     return ret;
 }
 
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      count_chars()
+ * 
+ * DESCRIPTION
+ *      The sink used by vf_write_measure().  Given NULL text (see
+ *      count_base64_quads()) as well as real text.
+ *
+ * RETURNS
+ *      TRUE.
+ *----------------------------------------------------------------------------*/
+
+bool_t count_chars(
+    void *p_context,                /* The count */
+    const char *p_chars,            /* The text (may be NULL) */
+    uint32_t numchars,              /* Number of characters */
+    bool_t stable                   /* Text stays put till the write's done? */
+    )
+{
+    (void)p_chars;
+    (void)stable;
+
+    *((size_t *)p_context) += numchars;
+
+    return TRUE;
+}
+
 /*----------------------------------------------------------------------------*
  * NAME
  *      deallocate_writer()
@@ -1097,6 +1564,7 @@ void deallocate_writer(
     {
         vf_free(p_vwriter->p_saved_text);
         p_vwriter->p_saved_text = NULL;
+        p_vwriter->saved_alloc = 0;
     }
 
     while (p_vwriter->p_stack)
@@ -178,6 +178,9 @@ static const char vf_iface_h_vss_id[] = "$Header: /cvsroot/vformat/src/vformat/v
 /* We make heavy use of varargs()... */
 #include <stdarg.h>
 
+/* ...and size_t for writer buffer sizes */
+#include <stddef.h>
+
 /* Default .DLL build using the symbols maintained by MSDEV */
 #if defined(WIN) || defined(WIN32)
 #include "vf_win32libs.h"
@@ -518,16 +521,90 @@ typedef bool_t (*vf_write_callback_t)(
     void *p_context             /* A bit more callback context */
     );
 
+/*----------------------------------------------------------------------------*
+ * PURPOSE
+ *      Type of user supplied callback function for vf_parse_init_callback().
+ *      Return TRUE to take ownership of the object (delete it later with
+ *      vf_delete_object()), FALSE to have the parser delete it.
+ *----------------------------------------------------------------------------*/
+
+typedef bool_t (*vf_parse_callback_t)(
+    VF_OBJECT_T *p_object,      /* Completed top level object */
+    uint32_t n_context,         /* Callback context */
+    void *p_context             /* A bit more callback context */
+    );
+
 /*----------------------------------------------------------------------------*
  * PURPOSE
  *      Various flags controlling the behavious of the vf_write_xxx() calls.
- *  TODO: generalise this to similar behaviours in the vf_read_xxx() calls.
- *  eg. skip binary objects, etc.
+ *      The parser has its own, see vf_parse_flags_t.
+ *
+ *      VFWF_ATOMIC - vf_write_file() writes to a temporary file next to the
+ *      one named and renames it into place once it is complete, so readers
+ *      see either the old file or the whole of the new one.  On POSIX the
+ *      temporary file has a unique name, keeps the mode of the file it
+ *      replaces and is synced, along with its directory, around the rename.
+ *      Where rename() won't replace an existing file (Windows) the write
+ *      fails instead.
+ *
+ *      VFWF_MODIFIEDOBJECTS - only top level objects which have been modified
+ *      (see vf_is_modified()) are written.
+ *
+ *      VFWF_MODIFIEDPROPS - only properties which have been modified are
+ *      written, along with VERSION, N and UID so the receiver can tell
+ *      which object they belong to.  Together with VFWF_MODIFIEDOBJECTS
+ *      this gives just the changes since vf_clear_modified() was called.
  *----------------------------------------------------------------------------*/
 
 typedef uint16_t vf_write_flags_t;
 
 #define VFWF_WRITEALL       ((vf_write_flags_t)0x0001)
+#define VFWF_ATOMIC         ((vf_write_flags_t)0x0002)
+#define VFWF_MODIFIEDOBJECTS ((vf_write_flags_t)0x0004)
+#define VFWF_MODIFIEDPROPS  ((vf_write_flags_t)0x0008)
+
+/*----------------------------------------------------------------------------*
+ * PURPOSE
+ *      Flags controlling the behaviour of a parser, see vf_parse_set_flags().
+ *
+ *      VFPF_LAZYDECODE - keep BASE64 and QUOTED-PRINTABLE values as read and
+ *      decode each one the first time it's asked for, by vf_get_prop_value(),
+ *      vf_get_prop_value_string() or vf_get_prop_value_base64().  Values that
+ *      are never looked at are never decoded, and a BASE64 value that hasn't
+ *      been is written back out without a decode / encode round trip.
+ *
+ *      VFPF_SKIPBINARY - drop BASE64 properties (PHOTO, LOGO, SOUND etc.)
+ *      as they're read.  The value is stepped over without being stored or
+ *      decoded.  See also vf_parse_set_filter().
+ *
+ *      VFPF_RECOVER - on a syntax error (a bad QUOTED-PRINTABLE escape, an
+ *      unknown encoding etc.) drop the property in error and carry on from
+ *      the next line which isn't part of it, rather than deleting the whole
+ *      tree and failing.  vf_parse_text() then only fails for lack of memory.
+ *      See also vf_parse_set_diagnostics().
+ *----------------------------------------------------------------------------*/
+
+typedef uint16_t vf_parse_flags_t;
+
+#define VFPF_LAZYDECODE     ((vf_parse_flags_t)0x0001)
+#define VFPF_SKIPBINARY     ((vf_parse_flags_t)0x0002)
+#define VFPF_RECOVER        ((vf_parse_flags_t)0x0004)
+
+/*----------------------------------------------------------------------------*
+ * PURPOSE
+ *      VF_PARSE_DIAG_T records the errors found by a parser, see
+ *      vf_parse_set_diagnostics().  Offsets count characters from the start
+ *      of the first text passed to vf_parse_text().
+ *----------------------------------------------------------------------------*/
+
+typedef struct VF_PARSE_DIAG_T
+{
+    uint32_t    n_errors;           /* Syntax errors found */
+    uint32_t    first_offset;       /* Offset of the first */
+    uint32_t    last_offset;        /* Offset of the most recent */
+    bool_t      out_of_memory;      /* Parse failed for lack of memory */
+}
+VF_PARSE_DIAG_T;
 
 /*----------------------------------------------------------------------------*
  * PURPOSE
@@ -589,12 +666,125 @@ extern VFORMATDECLSPEC bool_t vf_parse_init(
     VF_OBJECT_T **pp_object         /* The object we're parsing into */
     );
 
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      vf_parse_init_arena()
+ * 
+ * DESCRIPTION
+ *      As vf_parse_init() but the objects parsed are built in an arena, a few
+ *      large blocks of memory rather than a separate allocation for every
+ *      object, property and string.  size_hint gives the size of the first
+ *      block (the size of the text to be parsed is a reasonable guess), pass
+ *      zero if not known.
+ *
+ *      The tree is deleted with vf_delete_object(..., TRUE) as usual, which
+ *      releases the arena in one go rather than walking the tree.  The tree
+ *      can still be modified, replaced values are allocated from the heap &
+ *      the tree is then walked when it's deleted.  Memory replaced within
+ *      the arena isn't reclaimed until the whole tree is deleted.
+ *
+ * RETURNS
+ *      TRUE iff parser allocated successfully.
+ *----------------------------------------------------------------------------*/
+
+extern VFORMATDECLSPEC bool_t vf_parse_init_arena(
+    VF_PARSER_T **pp_parser,        /* Ptr to allocated parser */
+    VF_OBJECT_T **pp_object,        /* The object we're parsing into */
+    uint32_t size_hint              /* Expected size of the tree, 0 if unknown */
+    );
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      vf_parse_init_callback()
+ * 
+ * DESCRIPTION
+ *      As vf_parse_init(), except that rather than being kept in a list
+ *      each top level object is passed to p_callback as soon as its END has
+ *      been read.  Memory use is then bounded by the largest object, not
+ *      the size of the input, so this suits importing large files one
+ *      card at a time.  Text is passed in with vf_parse_text() as usual,
+ *      or see vf_read_file_to_callback().
+ *
+ *      An object left without an END by vf_parse_end() is incomplete and
+ *      is deleted rather than passed to the callback.
+ *
+ * RETURNS
+ *      TRUE iff parser allocated successfully.
+ *----------------------------------------------------------------------------*/
+
+extern VFORMATDECLSPEC bool_t vf_parse_init_callback(
+    VF_PARSER_T **pp_parser,        /* The parser */
+    vf_parse_callback_t p_callback, /* Called with each top level object */
+    uint32_t n_context,             /* Callback context */
+    void *p_context                 /* A bit more callback context */
+    );
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      vf_parse_set_flags()
+ * 
+ * DESCRIPTION
+ *      Set flags (VFPF_xxx) altering the behaviour of a parser.  Call before
+ *      the first vf_parse_text().
+ *
+ * RETURNS
+ *      TRUE <=> flags set, FALSE else.
+ *----------------------------------------------------------------------------*/
+
+extern VFORMATDECLSPEC bool_t vf_parse_set_flags(
+    VF_PARSER_T *p_parser,          /* The parser */
+    vf_parse_flags_t flags          /* VFPF_xxx flags */
+    );
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      vf_parse_set_filter()
+ * 
+ * DESCRIPTION
+ *      Restrict the properties a parser adds to the tree.  pp_names is a
+ *      NULL terminated list of property names (without any group), such as
+ *      { VFP_UNIQUESTRING, VFP_NAME, VFP_TELEPHONE, NULL }.  If allow is
+ *      TRUE only properties named in the list are kept, else those named
+ *      are dropped.
+ *      Dropped values are stepped over without being stored or decoded.
+ *      BEGIN and END are always kept.  A NULL or empty list removes the
+ *      filter.  Call before the first vf_parse_text().
+ *
+ * RETURNS
+ *      TRUE <=> allocation OK, FALSE else.
+ *----------------------------------------------------------------------------*/
+
+extern VFORMATDECLSPEC bool_t vf_parse_set_filter(
+    VF_PARSER_T *p_parser,          /* The parser */
+    const char **pp_names,          /* NULL terminated list of names */
+    bool_t allow                    /* Keep only these (TRUE) or drop them */
+    );
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      vf_parse_set_diagnostics()
+ * 
+ * DESCRIPTION
+ *      Have a parser record the errors it finds in *p_diag, which is cleared
+ *      and must remain valid till vf_parse_end().  Syntax errors are counted
+ *      whether or not VFPF_RECOVER is set.
+ *
+ * RETURNS
+ *      TRUE <=> diagnostics set, FALSE else.
+ *----------------------------------------------------------------------------*/
+
+extern VFORMATDECLSPEC bool_t vf_parse_set_diagnostics(
+    VF_PARSER_T *p_parser,          /* The parser */
+    VF_PARSE_DIAG_T *p_diag         /* Where to record errors, NULL for nowhere */
+    );
+
 /*----------------------------------------------------------------------------*
  * NAME
  *      vf_parse_text()
  * 
  * DESCRIPTION
  *      Parse indicated text into the object associated with the VPARSE_T.
+ *      On failure the tree built so far is deleted, but see VFPF_RECOVER.
  *
  *      See notes for vf_parse_init().
  *
@@ -625,6 +815,70 @@ extern VFORMATDECLSPEC bool_t vf_parse_end(
     VF_PARSER_T *p_parse            /* The parser */
     );
 
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      vf_parse_buffer()
+ * 
+ * DESCRIPTION
+ *      Parse a complete, caller owned buffer in one go, without copying the
+ *      unencoded name and value fields.  These are left pointing into the
+ *      buffer, each one terminated by overwriting the delimiter after it
+ *      with a NULL.  QUOTED-PRINTABLE fields are decoded in place within
+ *      the buffer.  BASE64 data and folded lines are allocated as usual.
+ *
+ *      The buffer therefore:
+ *
+ *          - is modified by the parse & can't be parsed again,
+ *          - must remain valid and unmoved until the resulting object is
+ *            deleted with vf_delete_object().
+ *
+ *      Strings returned by vf_get_prop_value_string(), vf_get_prop_name_string()
+ *      etc. may point into the buffer.  Setting a name or value replaces the
+ *      field with an allocated copy in the normal way & vf_clone_object()
+ *      produces an object with no references to the buffer.
+ *
+ * RETURNS
+ *      TRUE <=> allocation & syntax OK, FALSE else.
+ *----------------------------------------------------------------------------*/
+
+extern VFORMATDECLSPEC bool_t vf_parse_buffer(
+    VF_OBJECT_T **pp_object,        /* The object we're parsing into */
+    char *p_buffer,                 /* Caller's buffer, modified by the parse */
+    uint32_t length                 /* Number of characters in the buffer */
+    );
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      vf_parse_buffer_parallel()
+ * 
+ * DESCRIPTION
+ *      Parse a complete buffer holding a list of top level objects, such as
+ *      a phonebook export, using up to n_threads threads.  The buffer is cut
+ *      into slices at the BEGIN lines of top level objects, each slice is
+ *      parsed into an arena of its own & the resulting lists are joined up
+ *      in order.  The list produced is the same as vf_parse_text() would
+ *      produce - if a cut turns out not to have been between objects, the
+ *      text from there on is simply parsed again on the calling thread.
+ *
+ *      Unlike vf_parse_buffer(), the buffer isn't modified & nothing points
+ *      into it once the call returns.
+ *
+ *      Threads are only used if the library is built with HAS_PTHREAD_H
+ *      defined (the default everywhere but Windows), otherwise the slices
+ *      are parsed one after another.  If they are, the memory functions
+ *      (see vf_malloc.h) must be thread safe.
+ *
+ * RETURNS
+ *      TRUE <=> allocation & syntax OK, FALSE else.
+ *----------------------------------------------------------------------------*/
+
+extern VFORMATDECLSPEC bool_t vf_parse_buffer_parallel(
+    VF_OBJECT_T **pp_object,        /* The object we're parsing into */
+    const char *p_buffer,           /* Caller's buffer, not modified */
+    uint32_t length,                /* Number of characters in the buffer */
+    uint32_t n_threads              /* Most threads to use, including the caller's */
+    );
+
 /*---------------------------------------------------------------------------*
  * NAME
  *      vf_read_file()
@@ -641,6 +895,25 @@ extern VFORMATDECLSPEC bool_t vf_read_file(
     const char *p_name              /* Name of file to read */
     );
 
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      vf_read_file_to_callback()
+ * 
+ * DESCRIPTION
+ *      Reads indicated VOBJECT_T file, passing each top level object to a
+ *      callback as it is completed.  See vf_parse_init_callback().
+ *
+ * RETURNS
+ *      TRUE <=> read OK, FALSE else.
+ *---------------------------------------------------------------------------*/
+
+extern VFORMATDECLSPEC bool_t vf_read_file_to_callback(
+    const char *p_name,             /* Name of file to read */
+    vf_parse_callback_t p_callback, /* Called with each top level object */
+    uint32_t n_context,             /* Callback context */
+    void *p_context                 /* A bit more callback context */
+    );
+
 /*----------------------------------------------------------------------------*
  * NAME
  *      vf_write_init()
@@ -655,8 +928,8 @@ extern VFORMATDECLSPEC bool_t vf_read_file(
  *
  *      Various flags are available to influence which parts of the object
  *      are streamed.  It is up to the caller to provide buffer space for
- *      the conversion (see vf_write_to_buf()).  Usually the process looks
- *      like this:
+ *      the conversion (see vf_write_to_buf() and vf_write_to_buf_ex()).
+ *      Usually the process looks like this:
  *
  *          VF_WRITER_T *p_writer;
  *
@@ -714,6 +987,26 @@ extern VFORMATDECLSPEC bool_t vf_write_to_buf(
     uint16_t *p_byteswritten        /* Ptr to return count via */
     );
 
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      vf_write_to_buf_ex()
+ * 
+ * DESCRIPTION
+ *      As vf_write_to_buf() but taking a size_t buffer size, so callers with
+ *      big buffers can have them filled in one call.
+ *
+ * RETURNS
+ *      TRUE <=> written OK, FALSE else.  Consult the *p_byteswritten value
+ *      to determine if the conversion operation has finished.
+ *----------------------------------------------------------------------------*/
+
+extern VFORMATDECLSPEC bool_t vf_write_to_buf_ex(
+    VF_WRITER_T *p_writer,          /* The writer we're asking to write */
+    char *p_buffer,                 /* Buffer to write to */
+    size_t bufsize,                 /* Size of buffer */
+    size_t *p_byteswritten          /* Ptr to return count via */
+    );
+
 /*----------------------------------------------------------------------------*
  * NAME
  *      vf_write_end()
@@ -748,6 +1041,53 @@ extern VFORMATDECLSPEC bool_t vf_write_file(
     vf_write_flags_t flags          /* Flags controlling operation */
     );
 
+/*---------------------------------------------------------------------------*
+ * NAME
+ *      vf_write_fd()
+ * 
+ * DESCRIPTION
+ *      Write indicated vobject to an open file descriptor (a file, pipe or
+ *      socket).  Text is written in large batches, with writev() where
+ *      <sys/uio.h> is available (HAS_SYS_UIO_H in vf_config.h).  The
+ *      descriptor is left open.
+ *
+ * RETURNS
+ *      TRUE <=> written OK, FALSE else.
+ *---------------------------------------------------------------------------*/
+
+extern VFORMATDECLSPEC bool_t vf_write_fd(
+    int fd,                         /* Where to write */
+    VF_OBJECT_T *p_object,          /* The object to write */
+    vf_write_flags_t flags          /* Flags controlling operation */
+    );
+
+/*---------------------------------------------------------------------------*
+ * NAME
+ *      vf_write_fd_parallel()
+ * 
+ * DESCRIPTION
+ *      As vf_write_fd(), for a list of top level objects such as a whole
+ *      phonebook, using up to n_threads threads.  The list is cut into runs
+ *      of consecutive objects which are written at the same time, the first
+ *      straight to the descriptor & the others to buffers which follow it
+ *      in order.  The text is exactly what vf_write_fd() would write.
+ *
+ *      Threads are only used if the library is built with HAS_PTHREAD_H
+ *      defined (the default everywhere but Windows), and the memory
+ *      functions (see vf_malloc.h) must then be thread safe.  Nothing else
+ *      may use the objects during the call.
+ *
+ * RETURNS
+ *      TRUE <=> written OK, FALSE else.
+ *---------------------------------------------------------------------------*/
+
+extern VFORMATDECLSPEC bool_t vf_write_fd_parallel(
+    int fd,                         /* Where to write */
+    VF_OBJECT_T *p_object,          /* The object to write */
+    vf_write_flags_t flags,         /* Flags controlling operation */
+    uint32_t n_threads              /* Most threads to use, including the caller's */
+    );
+
 /*----------------------------------------------------------------------------*
  * NAME
  *      vf_write_to_callback()
@@ -778,6 +1118,93 @@ extern VFORMATDECLSPEC bool_t vf_write_to_callback(
     void *p_context             /* A bit more callback context */
     );
 
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      vf_write_to_callback_parallel()
+ * 
+ * DESCRIPTION
+ *      As vf_write_to_callback(), for a list of top level objects, using up
+ *      to n_threads threads as vf_write_fd_parallel() does.  The callback is
+ *      only ever called on the calling thread, with the text in order, each
+ *      time the buffer fills up & finally with no text.  A NULL buffer gets
+ *      a 64K one from the VFORMAT library heap.  The callback takes a
+ *      uint32_t count, so no more than 4GB - 1 of a bigger buffer is used.
+ *
+ * RETURNS
+ *      TRUE <=> written OK, FALSE else.
+ *----------------------------------------------------------------------------*/
+
+extern VFORMATDECLSPEC bool_t vf_write_to_callback_parallel(
+    VF_OBJECT_T *p_object,      /* The object to write */
+    char *p_buffer,             /* Buffer to use */
+    size_t bufsize,             /* Size of buffer to use */
+    vf_write_flags_t flags,     /* Flags controlling operation */
+    vf_write_callback_t cb,     /* The callback function */
+    uint32_t n_context,         /* Some callback context */
+    void *p_context,            /* A bit more callback context */
+    uint32_t n_threads          /* Most threads to use, including the caller's */
+    );
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      vf_measure_object()
+ * 
+ * DESCRIPTION
+ *      Find the exact number of characters vf_write_to_buf() etc. would
+ *      produce for an object (a Content-Length, say) without keeping the
+ *      text.  Lazily kept values are decoded, just as writing them would.
+ *
+ * RETURNS
+ *      TRUE <=> object could be written, FALSE else.
+ *----------------------------------------------------------------------------*/
+
+extern VFORMATDECLSPEC bool_t vf_measure_object(
+    VF_OBJECT_T *p_object,      /* The object to measure */
+    vf_write_flags_t flags,     /* Flags controlling operation */
+    size_t *p_length            /* Where to return the length */
+    );
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      vf_write_to_mem()
+ * 
+ * DESCRIPTION
+ *      Write the text form of an object into a single buffer.
+ *
+ *      If *pp_buffer is NULL the object is measured and a buffer of exactly
+ *      that size, plus a NULL terminator, is allocated from the VFORMAT
+ *      library heap and passed back.  Release it with vf_free_mem().
+ *      Otherwise the text is written to the bufsize bytes at *pp_buffer,
+ *      which isn't NULL terminated.
+ *
+ * RETURNS
+ *      TRUE <=> written OK, FALSE else.  *p_length gives the length of the
+ *      text or, if the caller's buffer was too small, the size it needs.
+ *----------------------------------------------------------------------------*/
+
+extern VFORMATDECLSPEC bool_t vf_write_to_mem(
+    VF_OBJECT_T *p_object,      /* The object to write */
+    vf_write_flags_t flags,     /* Flags controlling operation */
+    char **pp_buffer,           /* Buffer, *pp_buffer NULL => allocate one */
+    size_t bufsize,             /* Size of caller's buffer */
+    size_t *p_length            /* Where to return the length */
+    );
+
+/*----------------------------------------------------------------------------*
+ * NAME
+ *      vf_free_mem()
+ * 
+ * DESCRIPTION
+ *      Release a buffer allocated by vf_write_to_mem().
+ *
+ * RETURNS
+ *      (none)
+ *----------------------------------------------------------------------------*/
+
+extern VFORMATDECLSPEC void vf_free_mem(
+    char *p_buffer              /* Buffer to free */
+    );
+
 /*---------------------------------------------------------------------------*
  * NAME
  *      vf_get_next_object()
@@ -822,6 +1249,27 @@ extern VFORMATDECLSPEC VF_OBJECT_T *vf_create_object(
     VF_OBJECT_T *p_parent           /* Parent object if any */
     );
 
+/*---------------------------------------------------------------------------*
+ * NAME
+ *      vf_create_object_arena()
+ * 
+ * DESCRIPTION
+ *      As vf_create_object() but with no parent the object gets a new arena
+ *      (see vf_parse_init_arena()), size_hint giving the size of its first
+ *      block.  Objects created with a parent held in an arena are allocated
+ *      from the parent's arena, with a parent that isn't they come from the
+ *      heap as for vf_create_object().
+ *
+ * RETURNS
+ *      Ptr to object if created else NULL.
+ *---------------------------------------------------------------------------*/
+
+extern VFORMATDECLSPEC VF_OBJECT_T *vf_create_object_arena(
+    const char *p_type,             /* Type of object to create */
+    VF_OBJECT_T *p_parent,          /* Parent object if any */
+    uint32_t size_hint              /* Expected size of the tree, 0 if unknown */
+    );
+
 /*---------------------------------------------------------------------------*
  * NAME
  *      vf_clone_object()
@@ -1291,6 +1739,24 @@ extern VFORMATDECLSPEC bool_t vf_is_modified(
     VF_OBJECT_T *p_object           /* The object */
     );
 
+/*---------------------------------------------------------------------------*
+ * NAME
+ *      vf_clear_modified()
+ * 
+ * DESCRIPTION
+ *      Clear the modified flags of an object, its properties and any objects
+ *      it contains, eg. once the changes have been written out.  If all is
+ *      set the objects following it in the list are cleared too.
+ *
+ * RETURNS
+ *      (none)
+ *---------------------------------------------------------------------------*/
+
+extern VFORMATDECLSPEC void vf_clear_modified(
+    VF_OBJECT_T *p_object,          /* The object */
+    bool_t all                      /* Clear the rest of the list too? */
+    );
+
 /*----------------------------------------------------------------------------*
  * NAME
  *      vf_prop_belongs_to_object()